@@ -296,9 +296,19 @@ app_main(void)
     auto ota_updater_device = std::make_unique<TargetHttpdOtaUpdater>(*display);
 
     // Threads
-    auto route_service = std::make_unique<RouteService>(*map_metadata);
+    // The 32MiB PSRAM fits a node per water cell, so long routes are found in a single search
+    auto route_service = std::make_unique<RouteService>(*map_metadata, RouterNodeStore::kDense);
     auto storage = std::make_unique<Storage>(*target_nvm, state, route_service->AttachListener());
-    auto producer = std::make_unique<TileProducer>(state, *map_metadata);
+    // One tile decoder per core. With 32MiB PSRAM, cache 128 tiles (7.4MiB), so the overview
+    // maps and zoom switching don't have to decode anything again, and keep 4MiB of the
+    // compressed tiles to avoid most flash reads
+    auto producer = std::make_unique<TileProducer>(state,
+                                                   *map_metadata,
+                                                   TileProducerConfig {
+                                                       .cache_size = 128,
+                                                       .compressed_cache_size = 4 * 1024 * 1024,
+                                                       .decoder_threads = 2,
+                                                   });
     auto gps_simulator = std::make_unique<GpsSimulator>(*map_metadata, state, *route_service);
 
     // Selects between the real and demo GPS
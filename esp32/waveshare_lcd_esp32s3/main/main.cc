@@ -239,7 +239,16 @@ app_main(void)
     // Threads
     auto route_service = std::make_unique<RouteService>(*map_metadata);
     auto storage = std::make_unique<Storage>(*target_nvm, state, route_service->AttachListener());
-    auto producer = std::make_unique<TileProducer>(state, *map_metadata);
+    // One tile decoder per core, and caches which fit the 8MiB PSRAM (see doc/ram.md). The
+    // PNG tiles are decoded straight from the mapped flash, without the compressed tile cache
+    auto producer = std::make_unique<TileProducer>(state,
+                                                   *map_metadata,
+                                                   TileProducerConfig {
+                                                       .cache_size = kDefaultTileCacheSize,
+                                                       .compressed_cache_size = 0,
+                                                       .decoder_threads = 2,
+                                                       .direct_flash_decode = true,
+                                                   });
     auto gps_simulator = std::make_unique<GpsSimulator>(*map_metadata, state, *route_service);
 
     // Selects between the real and demo GPS
@@ -0,0 +1,23 @@
+#include "flash_host.hh"
+
+#include <cstring>
+
+void
+FlashHost::Read(const uint8_t* src, std::span<uint8_t> dst)
+{
+    memcpy(dst.data(), src, dst.size());
+    m_read_bytes += dst.size();
+    m_reads++;
+}
+
+uint64_t
+FlashHost::GetReadBytes() const
+{
+    return m_read_bytes;
+}
+
+uint64_t
+FlashHost::GetReads() const
+{
+    return m_reads;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "hal/i_flash.hh"
+
+#include <atomic>
+
+// The memory mapped map file, counting the bytes read like the flash on the target
+class FlashHost : public hal::IFlash
+{
+public:
+    void Read(const uint8_t* src, std::span<uint8_t> dst) final;
+
+    uint64_t GetReadBytes() const;
+
+    // The number of Read() calls
+    uint64_t GetReads() const;
+
+private:
+    std::atomic<uint64_t> m_read_bytes {0};
+    std::atomic<uint64_t> m_reads {0};
+};
@@ -109,7 +109,7 @@ private:
 
     std::vector<MapGpsRasterTile> m_gps_positions;
 
-    std::unique_ptr<Router<kTargetCacheSize>> m_router;
+    std::unique_ptr<Router<DenseNodeStore>> m_router;
 
     std::span<const IndexType> m_current_route;
 };
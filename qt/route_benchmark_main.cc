@@ -0,0 +1,197 @@
+#include "route_utils.hh"
+#include "router.hh"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <print>
+#include <random>
+
+namespace
+{
+
+struct Query
+{
+    IndexType from;
+    IndexType to;
+};
+
+// Random water cells, the same for a given seed and map
+std::vector<Query>
+CreateQueries(std::span<const uint32_t> land_mask, unsigned cells, unsigned count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<IndexType> distribution(0, cells - 1);
+    std::vector<Query> out;
+
+    auto water_cell = [&]() {
+        IndexType index;
+        do
+        {
+            index = distribution(rng);
+        } while (!IsWater(land_mask, index));
+
+        return index;
+    };
+
+    while (out.size() < count)
+    {
+        auto from = water_cell();
+        out.push_back({from, water_cell()});
+    }
+
+    return out;
+}
+
+// In cells
+double
+RouteLength(std::span<const IndexType> route, unsigned row_size)
+{
+    auto out = 0.0;
+
+    for (auto i = 1u; i < route.size(); i++)
+    {
+        auto dx = static_cast<int>(route[i] % row_size) - static_cast<int>(route[i - 1] % row_size);
+        auto dy = static_cast<int>(route[i] / row_size) - static_cast<int>(route[i - 1] / row_size);
+
+        out += std::sqrt(dx * dx + dy * dy);
+    }
+
+    return out;
+}
+
+template <typename NodeStore>
+void
+RunQueries(const char* name,
+           Router<NodeStore>& router,
+           std::span<const Query> queries,
+           unsigned row_size)
+{
+    auto found = 0u;
+    auto length = 0.0;
+    unsigned long expanded = 0;
+    unsigned long abstract_expanded = 0;
+    unsigned long partial_paths = 0;
+
+    const auto before = std::chrono::steady_clock::now();
+    for (auto [from, to] : queries)
+    {
+        auto route = router.CalculateRoute(from, to);
+        auto stats = router.GetStats();
+
+        if (!route.empty())
+        {
+            found++;
+            length += RouteLength(route, row_size);
+        }
+        expanded += stats.nodes_expanded;
+        abstract_expanded += stats.abstract_nodes_expanded;
+        partial_paths += stats.partial_paths;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - before);
+
+    std::print("{:>14} {:>7} {:>12} {:>10} {:>8} {:>10} {:>12.0f}\n",
+               name,
+               found,
+               expanded,
+               abstract_expanded,
+               partial_paths,
+               elapsed.count(),
+               length);
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+
+    parser.addOptions({
+        {{"m", "map"}, "Path to the map file", "map_file"},
+        {{"q", "queries"}, "Number of routes to calculate", "queries"},
+        {{"s", "seed"}, "Seed for the random start and goal cells", "seed"},
+    });
+
+    parser.process(a);
+
+    QString map_file = "map.bin";
+    if (parser.isSet("map"))
+    {
+        map_file = parser.value("map");
+    }
+    auto query_count = 50u;
+    if (parser.isSet("queries"))
+    {
+        query_count = parser.value("queries").toUInt();
+    }
+    auto seed = 1u;
+    if (parser.isSet("seed"))
+    {
+        seed = parser.value("seed").toUInt();
+    }
+
+    auto bin_file = QFile(map_file);
+    if (!bin_file.open(QIODevice::ReadOnly))
+    {
+        std::print("Failed to open {}\n", map_file.toStdString());
+        return 1;
+    }
+
+    auto mmap_bin = bin_file.map(0, bin_file.size());
+    if (!mmap_bin)
+    {
+        std::print("Failed to map {}\n", map_file.toStdString());
+        return 1;
+    }
+
+    auto map_metadata = reinterpret_cast<const MapMetadata*>(mmap_bin);
+    const auto row_size = map_metadata->land_mask_row_size;
+    const auto rows = map_metadata->land_mask_rows;
+
+    // Same as the RouteService
+    std::vector<uint32_t> land_mask((rows * row_size) / 32);
+    memcpy(land_mask.data(),
+           mmap_bin + map_metadata->land_mask_data_offset,
+           land_mask.size() * sizeof(uint32_t));
+
+    auto queries = CreateQueries(land_mask, row_size * rows, query_count, seed);
+
+    std::print("{} routes on a {}x{} land mask, seed {}\n", queries.size(), row_size, rows, seed);
+    std::print("{:>14} {:>7} {:>12} {:>10} {:>8} {:>10} {:>12}\n",
+               "router",
+               "found",
+               "expanded",
+               "abstract",
+               "partial",
+               "time (ms)",
+               "length");
+
+    auto flat = std::make_unique<Router<DenseNodeStore>>(land_mask, rows, row_size);
+    RunQueries("flat", *flat, queries, row_size);
+
+    flat->SetBidirectional(true);
+    RunQueries("bidirectional", *flat, queries, row_size);
+    flat->SetBidirectional(false);
+
+    if (map_metadata->HasRouteClusters())
+    {
+        auto clusters = reinterpret_cast<const RouteClusterHeader*>(
+            mmap_bin + map_metadata->route_cluster_offset);
+        auto hierarchical =
+            std::make_unique<Router<DenseNodeStore>>(land_mask, rows, row_size, clusters);
+
+        RunQueries("hierarchical", *hierarchical, queries, row_size);
+    }
+    else
+    {
+        std::print("No route clusters in the map, see tiler.py --route-cluster-size\n");
+    }
+
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include "flash_host.hh"
 #include "gps_listener.hh"
 #include "gps_reader.hh"
 #include "gps_simulator.hh"
@@ -19,6 +20,7 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QFile>
+#include <QTimer>
 #include <print>
 #include <stdlib.h>
 
@@ -32,6 +34,7 @@ main(int argc, char* argv[])
         {{"s", "seed"}, "Random seed", "seed"},
         {{"u", "updated"}, "Set the application updated flag"},
         {{"m", "map"}, "Path to the map file", "map_file"},
+        {{"r", "record"}, "Record the boat positions, for tools/flash_pages.py", "voyage_file"},
     });
 
     parser.process(a);
@@ -98,9 +101,19 @@ main(int argc, char* argv[])
                map_metadata->lowest_longitude,
                map_metadata->highest_longitude);
 
-    auto route_service = std::make_unique<RouteService>(*map_metadata);
+    // Dense router nodes, like the P4 target
+    auto route_service = std::make_unique<RouteService>(*map_metadata, RouterNodeStore::kDense);
     auto storage = std::make_unique<Storage>(*nvm, state, route_service->AttachListener());
-    auto producer = std::make_unique<TileProducer>(state, *map_metadata);
+    // Two tile decoders and large caches, like the P4 target
+    auto flash = std::make_unique<FlashHost>();
+    auto producer = std::make_unique<TileProducer>(state,
+                                                   *map_metadata,
+                                                   TileProducerConfig {
+                                                       .cache_size = 128,
+                                                       .compressed_cache_size = 4 * 1024 * 1024,
+                                                       .decoder_threads = 2,
+                                                       .flash = flash.get(),
+                                                   });
     auto gps_simulator = std::make_unique<GpsSimulator>(*map_metadata, state, *route_service);
     auto gps_listener = std::make_unique<GpsListener>(*gps_simulator);
 
@@ -152,6 +165,56 @@ main(int argc, char* argv[])
 
     window.show();
 
+    // The tile cache hit rates, the flash reads saved by the compressed tile cache, and the
+    // decode/wait times
+    QTimer tile_stats_timer;
+    QObject::connect(&tile_stats_timer, &QTimer::timeout, [&producer, &flash]() {
+        auto stats = producer->GetStats();
+        auto percent = [](auto hits, auto misses) {
+            return hits + misses == 0 ? 0 : 100 * hits / (hits + misses);
+        };
+
+        std::print("Tiles: decoded hits {}%, compressed hits {}%, flash read {} KiB, saved {} "
+                   "KiB\n",
+                   percent(stats.cache_hits, stats.cache_misses),
+                   percent(stats.compressed.hits, stats.compressed.misses),
+                   flash->GetReadBytes() / 1024,
+                   stats.compressed.saved_flash_bytes / 1024);
+        std::print("  {} evictions, decode avg {} us (p90 {} us, max {} us), blocked {} times, avg "
+                   "{} us (max {} us), queue {} (max {})\n",
+                   stats.evictions,
+                   stats.decode_time.Average().count(),
+                   stats.decode_time.Percentile(90).count(),
+                   stats.decode_time.Max().count(),
+                   stats.lock_wait_time.count,
+                   stats.lock_wait_time.Average().count(),
+                   stats.lock_wait_time.Max().count(),
+                   stats.queue_depth,
+                   stats.max_queue_depth);
+    });
+    tile_stats_timer.start(10000);
+
+    // The global pixel position once a second, one "x y" per line
+    QTimer record_timer;
+    std::unique_ptr<FILE, decltype(&fclose)> voyage_file(nullptr, fclose);
+    if (parser.isSet("record"))
+    {
+        voyage_file.reset(fopen(parser.value("record").toStdString().c_str(), "w"));
+        if (!voyage_file)
+        {
+            std::print("Failed to open {}\n", parser.value("record").toStdString());
+            return 1;
+        }
+
+        QObject::connect(&record_timer, &QTimer::timeout, [&state, &voyage_file]() {
+            auto position = *state.CheckoutReadonly().Get<AS::pixel_position>();
+
+            std::print(voyage_file.get(), "{} {}\n", position.x, position.y);
+            fflush(voyage_file.get());
+        });
+        record_timer.start(1000);
+    }
+
     //    route_service->RequestRoute({2592, 7032}, {16008, 4728});
     //route_service->RequestRoute({8735,6117}, {9771, 6493});
     auto out = QApplication::exec();
@@ -0,0 +1,408 @@
+#include "application_state.hh"
+#include "flash_host.hh"
+#include "pixel_kernels.hh"
+#include "tile_decoder.hh"
+#include "tile_producer.hh"
+#include "time.hh"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <array>
+#include <chrono>
+#include <print>
+#include <stdlib.h>
+
+namespace
+{
+
+// The tiles of the zoom-4 overview map, centered around the middle of the map. The tiles are
+// tile_zoom times kTileSize, i.e., 4 for the zoomed out tiles in the map
+std::vector<Point>
+OverviewTiles(const MapMetadata& metadata, unsigned tile_zoom)
+{
+    const auto tile_size = static_cast<int>(kTileSize * tile_zoom);
+    std::vector<Point> out;
+
+    const auto width = hal::kDisplayWidth * 4;
+    const auto height = hal::kDisplayHeight * 4;
+    const auto left =
+        std::max(0, static_cast<int>(metadata.tile_row_size * kTileSize - width) / 2);
+    const auto top = std::max(0, static_cast<int>(metadata.tile_rows * kTileSize - height) / 2);
+
+    for (auto y = top - top % tile_size; y < top + height; y += tile_size)
+    {
+        for (auto x = left - left % tile_size; x < left + width; x += tile_size)
+        {
+            out.push_back({x, y});
+        }
+    }
+
+    return out;
+}
+
+// Same as the map screen overview fill: request, draw what's ready, wait for the rest
+milliseconds
+FillOverview(TileProducer& producer, std::vector<Point> tiles, unsigned tile_zoom)
+{
+    os::binary_semaphore ready {0};
+    const auto center = tiles[tiles.size() / 2];
+    const auto before = os::GetTimeStamp();
+
+    while (!tiles.empty())
+    {
+        auto pending =
+            producer.RequestTiles(tiles, center, ready, tile_zoom, TilePriority::kOverview);
+
+        std::erase_if(tiles, [&producer, &ready, pending, tile_zoom](const auto& position) {
+            auto tile = producer.TryLockTile(position, ready, tile_zoom, TilePriority::kOverview);
+            return tile != nullptr || pending == 0;
+        });
+
+        if (!tiles.empty())
+        {
+            ready.acquire();
+        }
+    }
+
+    return os::GetTimeStamp() - before;
+}
+
+// Decode every tile in the map, single threaded. Either copied to RAM first, or straight from
+// flash (through the counting flash mapping in both cases)
+void
+DecodeAllTiles(const MapMetadata& metadata, bool direct_flash_decode)
+{
+    const auto start = reinterpret_cast<const uint8_t*>(&metadata);
+    const auto flash_tiles =
+        reinterpret_cast<const FlashTile*>(start + metadata.tile_data_offset);
+    const auto tiles =
+        std::span<const FlashTile>(flash_tiles, metadata.tile_row_size * metadata.tile_rows);
+    TileDecoder decoder(std::ranges::max(tiles, {}, [](const auto& tile) {
+                            return static_cast<size_t>(tile.size);
+                        }).size);
+    IndexedTile dst;
+    FlashHost flash;
+
+    struct CodecStats
+    {
+        const char* name;
+        unsigned tiles;
+        uint64_t bytes;
+        uint64_t flash_reads;
+        std::chrono::nanoseconds time;
+    };
+    std::array<CodecStats, 2> stats {{{"png", 0, 0, 0, {}}, {"palette rle", 0, 0, 0, {}}}};
+
+    for (auto i = 0u; i < metadata.tile_row_size * metadata.tile_rows; i++)
+    {
+        const auto& tile = flash_tiles[i];
+        const auto src = start + tile.flash_offset;
+
+        if (tile.codec >= stats.size())
+        {
+            continue;
+        }
+        const auto reads = flash.GetReads();
+        auto before = std::chrono::steady_clock::now();
+
+        if (direct_flash_decode)
+        {
+            decoder.DecodeFromFlash(static_cast<TileCodec>(tile.codec), flash, src, tile.size, dst);
+        }
+        else
+        {
+            auto staging = decoder.GetStagingBuffer(tile.size);
+
+            flash.Read(src, staging);
+            decoder.Decode(static_cast<TileCodec>(tile.codec), staging, dst);
+        }
+
+        auto& codec = stats[tile.codec];
+        codec.time += std::chrono::steady_clock::now() - before;
+        codec.tiles++;
+        codec.bytes += tile.size;
+        codec.flash_reads += flash.GetReads() - reads;
+    }
+
+    for (const auto& codec : stats)
+    {
+        if (codec.tiles == 0)
+        {
+            continue;
+        }
+
+        std::print("  {}: {} tiles, {} bytes and {} flash reads per tile, {} ns per tile\n",
+                   codec.name,
+                   codec.tiles,
+                   codec.bytes / codec.tiles,
+                   codec.flash_reads / codec.tiles,
+                   codec.time.count() / codec.tiles);
+    }
+}
+
+// Decode every PNG tile in the map with both PalettePngDecoder and PNGdec, and compare the
+// output and the time per tile
+bool
+ComparePngDecoders(const MapMetadata& metadata)
+{
+    const auto start = reinterpret_cast<const uint8_t*>(&metadata);
+    const auto flash_tiles =
+        reinterpret_cast<const FlashTile*>(start + metadata.tile_data_offset);
+    const auto tiles =
+        std::span<const FlashTile>(flash_tiles, metadata.tile_row_size * metadata.tile_rows);
+    const auto max_size =
+        std::ranges::max(tiles, {}, [](const auto& tile) { return static_cast<size_t>(tile.size); })
+            .size;
+
+    TileDecoder palette_png(max_size);
+    TileDecoder pngdec(max_size, false);
+    IndexedTile tile;
+    IndexedTile expected;
+
+    unsigned decoded = 0;
+    unsigned mismatches = 0;
+    std::chrono::nanoseconds palette_png_time {};
+    std::chrono::nanoseconds pngdec_time {};
+
+    for (auto i = 0u; i < metadata.tile_row_size * metadata.tile_rows; i++)
+    {
+        const auto& flash_tile = flash_tiles[i];
+        if (static_cast<TileCodec>(flash_tile.codec) != TileCodec::kPng)
+        {
+            continue;
+        }
+        const auto data = std::span(start + flash_tile.flash_offset, flash_tile.size);
+
+        auto before = std::chrono::steady_clock::now();
+        auto ok = palette_png.Decode(TileCodec::kPng, data, tile);
+        palette_png_time += std::chrono::steady_clock::now() - before;
+
+        before = std::chrono::steady_clock::now();
+        auto expected_ok = pngdec.Decode(TileCodec::kPng, data, expected);
+        pngdec_time += std::chrono::steady_clock::now() - before;
+
+        // The palette entries past the used ones are undefined with PNGdec
+        auto same = ok == expected_ok && tile.pixels == expected.pixels;
+        for (auto index : tile.pixels)
+        {
+            same = same && tile.palette[index] == expected.palette[index];
+        }
+
+        if (!same)
+        {
+            std::print("  tile {} differs (decoded {}, PNGdec {})\n", i, ok, expected_ok);
+            mismatches++;
+        }
+        decoded++;
+    }
+
+    if (decoded == 0)
+    {
+        std::print("  No PNG tiles in the map\n");
+        return true;
+    }
+
+    std::print("  {} tiles, {} differ\n", decoded, mismatches);
+    std::print("  palette PNG decoder: {} ns per tile\n", palette_png_time.count() / decoded);
+    std::print("  PNGdec: {} ns per tile\n", pngdec_time.count() / decoded);
+
+    return mismatches == 0;
+}
+
+// Time a row kernel, in pixels per second
+template <typename Kernel>
+void
+TimeKernel(const char* name, unsigned pixels, Kernel kernel)
+{
+    constexpr auto kRows = 20000;
+
+    auto before = std::chrono::steady_clock::now();
+    for (auto row = 0; row < kRows; row++)
+    {
+        kernel();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - before;
+
+    std::print("  {}: {:.1f} Mpixels/s\n", name, kRows * pixels / elapsed.count() / 1e6);
+}
+
+void
+TimePixelKernels()
+{
+    std::array<uint8_t, kTileSize> indices;
+    std::array<uint16_t, 256> palette;
+    std::array<uint16_t, 256> hatched_palette;
+    std::array<uint16_t, kTileSize> rgb565;
+    std::array<uint8_t, kTileSize * 4> argb8888;
+
+    for (auto i = 0u; i < indices.size(); i++)
+    {
+        indices[i] = (i * 7) % 64;
+    }
+    for (auto i = 0u; i < palette.size(); i++)
+    {
+        palette[i] = i * 0x0841;
+        hatched_palette[i] = i % 4 == 0 ? 0xf800 : palette[i];
+    }
+
+    TimeKernel("indexed, reference", kTileSize, [&]() {
+        IndexedToRgb565RowReference(indices.data(), palette.data(), rgb565);
+    });
+    TimeKernel("indexed", kTileSize, [&]() {
+        IndexedToRgb565Row(indices.data(), palette.data(), rgb565);
+    });
+    TimeKernel("hatched, reference", kTileSize, [&]() {
+        HatchedIndexedToRgb565RowReference(
+            indices.data(), palette.data(), hatched_palette.data(), 0, rgb565);
+    });
+    TimeKernel("hatched", kTileSize, [&]() {
+        HatchedIndexedToRgb565Row(
+            indices.data(), palette.data(), hatched_palette.data(), 0, rgb565);
+    });
+    TimeKernel("argb8888, reference", kTileSize, [&]() {
+        Rgb565ToArgb8888RowReference(rgb565, argb8888.data(), 0xf81f);
+    });
+    TimeKernel("argb8888", kTileSize, [&]() {
+        Rgb565ToArgb8888Row(rgb565, argb8888.data(), 0xf81f);
+    });
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+
+    parser.addOptions({
+        {{"m", "map"}, "Path to the map file", "map_file"},
+        {{"t", "threads"}, "Maximum number of decoder threads", "threads"},
+        {{"r", "rounds"}, "Number of overview fills per thread count", "rounds"},
+        {{"c", "cache"}, "Number of tiles to cache", "tiles"},
+        {{"z", "compressed"}, "Size of the compressed tile cache", "bytes"},
+        {{"d", "decode"}, "Time decoding every tile in the map per codec instead"},
+        {{"f", "direct"}, "Decode the PNG tiles straight from flash"},
+        {{"k", "kernels"}, "Time the pixel conversion kernels instead"},
+        {{"p", "png"}, "Compare the palette PNG decoder with PNGdec over every tile instead"},
+    });
+
+    parser.process(a);
+
+    QString map_file = "map.bin";
+    if (parser.isSet("map"))
+    {
+        map_file = parser.value("map");
+    }
+    auto max_threads = 4u;
+    if (parser.isSet("threads"))
+    {
+        max_threads = parser.value("threads").toUInt();
+    }
+    auto rounds = 5u;
+    if (parser.isSet("rounds"))
+    {
+        rounds = parser.value("rounds").toUInt();
+    }
+    auto cache_size = static_cast<unsigned>(kDefaultTileCacheSize);
+    if (parser.isSet("cache"))
+    {
+        cache_size =
+            std::max(parser.value("cache").toUInt(), static_cast<unsigned>(kMinTileCacheSize));
+    }
+    size_t compressed_cache_size = kDefaultCompressedTileCacheSize;
+    if (parser.isSet("compressed"))
+    {
+        compressed_cache_size = parser.value("compressed").toULongLong();
+    }
+
+    const auto direct_flash_decode = parser.isSet("direct");
+
+    if (parser.isSet("kernels"))
+    {
+        std::print("Pixel conversion kernels, {} pixel rows\n", kTileSize);
+        TimePixelKernels();
+
+        return 0;
+    }
+
+    auto bin_file = QFile(map_file);
+    if (!bin_file.open(QIODevice::ReadOnly))
+    {
+        std::print("Failed to open {}\n", map_file.toStdString());
+        return 1;
+    }
+
+    auto mmap_bin = bin_file.map(0, bin_file.size());
+    if (!mmap_bin)
+    {
+        std::print("Failed to map {}\n", map_file.toStdString());
+        return 1;
+    }
+
+    auto map_metadata = reinterpret_cast<const MapMetadata*>(mmap_bin);
+
+    if (parser.isSet("png"))
+    {
+        std::print("Comparing the palette PNG decoder with PNGdec\n");
+
+        return ComparePngDecoders(*map_metadata) ? 0 : 1;
+    }
+
+    if (parser.isSet("decode"))
+    {
+        // Compare by creating the map with tiler.py --codec png and --codec rle
+        std::print("Decoding {} tiles, copied to RAM first\n",
+                   map_metadata->tile_row_size * map_metadata->tile_rows);
+        DecodeAllTiles(*map_metadata, false);
+        std::print("Decoding {} tiles, straight from flash\n",
+                   map_metadata->tile_row_size * map_metadata->tile_rows);
+        DecodeAllTiles(*map_metadata, true);
+
+        return 0;
+    }
+
+    // Maps without zoomed out tiles scale down the full size ones
+    const auto tile_zoom = map_metadata->HasZoomedTiles(1) ? 4u : 1u;
+    const auto tiles = OverviewTiles(*map_metadata, tile_zoom);
+
+    ApplicationState state;
+
+    // The producers are threads, which are never stopped. Keep them around until exit
+    std::vector<std::unique_ptr<TileProducer>> producers;
+
+    std::print("Filling the zoom-4 overview ({} tiles of {}x), {} rounds, {} cached tiles\n",
+               tiles.size(),
+               tile_zoom,
+               rounds,
+               cache_size);
+    for (auto threads = 1u; threads <= max_threads; threads++)
+    {
+        milliseconds total {0};
+
+        for (auto round = 0u; round < rounds; round++)
+        {
+            // A new producer each round, to start with a cold cache
+            auto& producer = producers.emplace_back(
+                std::make_unique<TileProducer>(state,
+                                               *map_metadata,
+                                               TileProducerConfig {
+                                                   .cache_size = cache_size,
+                                                   .compressed_cache_size = compressed_cache_size,
+                                                   .decoder_threads = threads,
+                                                   .direct_flash_decode = direct_flash_decode,
+                                               }));
+            producer->Start("tile_producer");
+
+            total += FillOverview(*producer, tiles, tile_zoom);
+        }
+
+        std::print("  {} decoder threads: {} ms per fill\n", threads, total.count() / rounds);
+    }
+
+    // Same as the simulator, the threads don't exit
+    exit(0);
+
+    return 0;
+}
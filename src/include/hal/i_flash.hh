@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace hal
+{
+
+class IFlash
+{
+public:
+    virtual ~IFlash() = default;
+
+    /**
+     * @brief Read from the memory mapped flash
+     *
+     * @param src the address in the mapped flash
+     * @param dst the destination, filled completely
+     */
+    virtual void Read(const uint8_t* src, std::span<uint8_t> dst) = 0;
+};
+
+} // namespace hal
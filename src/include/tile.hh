@@ -17,9 +17,20 @@ using CostType = uint32_t;
 // TILRSWFT
 constexpr auto kMetadataMagic = 0x54494C5253574654ull;
 
+// The zoomed out tile levels in the map, 1/2 and 1/4 scale
+constexpr auto kZoomedTileLevels = 2;
+
+enum class TileCodec : uint8_t
+{
+    kPng = 0,
+    // See tile_codec.hh
+    kPaletteRle = 1,
+};
+
 struct FlashTile
 {
-    uint32_t size;
+    uint32_t size : 24;
+    uint32_t codec : 8; // TileCodec, zero (PNG) in old maps
     uint32_t flash_offset;
 };
 static_assert(sizeof(FlashTile) == 8);
@@ -42,6 +53,7 @@ struct MapMetadata
     float highest_longitude;
     float highest_latitude;
 
+    // Including the default land tile, which has no FlashTile entry
     uint32_t tile_count;
     uint32_t tile_row_size;
     uint32_t tile_rows;
@@ -56,10 +68,71 @@ struct MapMetadata
     uint32_t tile_data_offset;
     uint32_t land_mask_data_offset;
     uint32_t gps_position_offset;
+
+    // The FlashTile tables of the zoomed out levels, where each tile covers 2x2 and 4x4 tiles.
+    // Zero if missing. Older maps end before this, see HasZoomedTiles()
+    uint32_t zoomed_tile_data_offset[kZoomedTileLevels];
+
+    // The RouteClusterHeader for hierarchical routing. Zero if missing, older maps end before this
+    uint32_t route_cluster_offset;
+    uint32_t reserved;
+
+    bool HasZoomedTiles(unsigned level) const
+    {
+        return HasField(offsetof(MapMetadata, zoomed_tile_data_offset) +
+                        level * sizeof(uint32_t)) &&
+               zoomed_tile_data_offset[level] != 0;
+    }
+
+    bool HasRouteClusters() const
+    {
+        return HasField(offsetof(MapMetadata, route_cluster_offset)) && route_cluster_offset != 0;
+    }
+
+private:
+    // The tiles follow the header, so fields past it are from a newer map format
+    bool HasField(size_t offset) const
+    {
+        return tile_data_offset >= offset + sizeof(uint32_t);
+    }
 };
 static_assert(offsetof(MapMetadata, tile_count) == 24);
 static_assert(offsetof(MapMetadata, land_mask_data_offset) == 56);
-static_assert(sizeof(MapMetadata) == 64);
+static_assert(sizeof(MapMetadata) == 80);
+
+/*
+ * The cluster graph for hierarchical routing, at MapMetadata::route_cluster_offset. The land
+ * mask is split into cluster_size x cluster_size clusters, and the nodes are the water cells
+ * where the routes can cross between two clusters. It's followed by
+ *
+ *   uint32_t first_node[cluster_row_size * cluster_rows + 1]
+ *   RouteClusterNode nodes[node_count + 1] (the last one only for its first_edge)
+ *   RouteClusterEdge edges[edge_count]
+ *
+ * The nodes are ordered by cluster, and the edges by node. The edges go to the node on the
+ * other side of the cluster border, and to the other nodes in the same cluster, with the cost
+ * of the cheapest path inside the cluster. See tools/route_data.py.
+ */
+struct RouteClusterHeader
+{
+    uint32_t cluster_size;
+    uint32_t cluster_row_size;
+    uint32_t cluster_rows;
+    uint32_t node_count;
+    uint32_t edge_count;
+};
+
+struct RouteClusterNode
+{
+    uint32_t index; // In the land mask
+    uint32_t first_edge;
+};
+
+struct RouteClusterEdge
+{
+    uint32_t to; // Node
+    uint32_t cost;
+};
 
 struct Point
 {
@@ -9,10 +9,19 @@
 #include <etl/queue_spsc_atomic.h>
 #include <etl/vector.h>
 
+enum class RouterNodeStore : uint8_t
+{
+    // A fixed size hash map (~512KiB), long routes are merged from partial paths
+    kHash,
+    // A word per water cell in the land mask (see DenseNodeStore), for targets with PSRAM to spare
+    kDense,
+};
+
 class RouteService : public os::BaseThread
 {
 public:
-    explicit RouteService(const MapMetadata& metadata);
+    explicit RouteService(const MapMetadata& metadata,
+                          RouterNodeStore node_store = RouterNodeStore::kHash);
 
     // Context: Another thread
     void RequestRoute(Point from, Point to);
@@ -35,6 +44,8 @@ private:
 
     std::optional<milliseconds> OnActivation() final;
 
+    std::span<const IndexType> CalculateRoute(IndexType from, IndexType to);
+
 
     const uint32_t m_row_size;
     const uint32_t m_rows;
@@ -44,6 +55,7 @@ private:
     etl::queue_spsc_atomic<std::pair<IndexType, IndexType>, 8> m_requested_route;
     etl::vector<RouteListenerImpl*, 4> m_listeners;
 
-    // Unique, to place this class in PSRAM
-    std::unique_ptr<Router<kTargetCacheSize>> m_router;
+    // Unique, to place this class in PSRAM. One of them is used
+    std::unique_ptr<Router<HashNodeStore<kTargetCacheSize>>> m_hash_router;
+    std::unique_ptr<Router<DenseNodeStore>> m_dense_router;
 };
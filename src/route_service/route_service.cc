@@ -39,7 +39,7 @@ private:
 };
 
 
-RouteService::RouteService(const MapMetadata& metadata)
+RouteService::RouteService(const MapMetadata& metadata, RouterNodeStore node_store)
     : m_row_size(metadata.land_mask_row_size)
     , m_rows(metadata.land_mask_rows)
 {
@@ -48,8 +48,24 @@ RouteService::RouteService(const MapMetadata& metadata)
     auto p = reinterpret_cast<const uint8_t*>(&metadata) + metadata.land_mask_data_offset;
     memcpy(m_land_mask.data(), p, m_land_mask.size() * sizeof(uint32_t));
 
-    m_router = std::make_unique<Router<kTargetCacheSize>>(
-        m_land_mask, metadata.land_mask_rows, metadata.land_mask_row_size);
+    // Read straight from the mapped flash
+    const RouteClusterHeader* clusters = nullptr;
+    if (metadata.HasRouteClusters())
+    {
+        clusters = reinterpret_cast<const RouteClusterHeader*>(
+            reinterpret_cast<const uint8_t*>(&metadata) + metadata.route_cluster_offset);
+    }
+
+    if (node_store == RouterNodeStore::kDense)
+    {
+        m_dense_router = std::make_unique<Router<DenseNodeStore>>(
+            m_land_mask, metadata.land_mask_rows, metadata.land_mask_row_size, clusters);
+    }
+    else
+    {
+        m_hash_router = std::make_unique<Router<HashNodeStore<kTargetCacheSize>>>(
+            m_land_mask, metadata.land_mask_rows, metadata.land_mask_row_size, clusters);
+    }
 }
 
 void
@@ -88,7 +104,7 @@ RouteService::OnActivation()
         {
             listener->PushEvent(IRouteListener::EventType::kCalculating, {});
         }
-        auto route = m_router->CalculateRoute(from, to);
+        auto route = CalculateRoute(from, to);
 
         for (auto listener : m_listeners)
         {
@@ -100,6 +116,17 @@ RouteService::OnActivation()
     return std::nullopt;
 }
 
+std::span<const IndexType>
+RouteService::CalculateRoute(IndexType from, IndexType to)
+{
+    if (m_dense_router)
+    {
+        return m_dense_router->CalculateRoute(from, to);
+    }
+
+    return m_hash_router->CalculateRoute(from, to);
+}
+
 Point
 RouteService::RandomWaterPoint() const
 {
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "tile.hh"
+
+#include <etl/priority_queue.h>
+#include <etl/unordered_map.h>
+#include <etl/vector.h>
+#include <limits>
+#include <span>
+#include <vector>
+
+constexpr IndexType kInvalidIndex = std::numeric_limits<IndexType>::max();
+
+enum class NodeState : uint8_t
+{
+    kUnknown,
+    kOpen,
+    kClosed,
+};
+
+// The A* information about a land mask cell
+struct RouterNode
+{
+    CostType g {0};
+    IndexType parent {kInvalidIndex};
+    NodeState state {NodeState::kUnknown};
+};
+
+// An entry in the open set. Improved nodes are pushed again, and the stale entries skipped
+struct OpenNode
+{
+    CostType f;
+    IndexType index;
+};
+
+struct CompareOpenNodes
+{
+    bool operator()(const OpenNode& lhs, const OpenNode& rhs) const
+    {
+        return lhs.f > rhs.f;
+    }
+};
+
+
+/**
+ * @brief Node store with a fixed number of nodes in a hash map
+ *
+ * Cleared before each search. When full, the router has to restart from the best partial path.
+ */
+template <size_t CACHE_SIZE>
+class HashNodeStore
+{
+    static_assert(CACHE_SIZE <= std::numeric_limits<uint16_t>::max());
+
+public:
+    // Same interface as the DenseNodeStore, the land mask is not needed here
+    HashNodeStore(std::span<const uint32_t>, unsigned)
+    {
+    }
+
+    void Reset()
+    {
+        m_open_set.clear();
+        m_nodes.clear();
+    }
+
+    /**
+     * @brief Lookup a node, a new one if not seen in this search
+     *
+     * @param index the land mask index
+     * @param out the node
+     *
+     * @return false if the store is full
+     */
+    bool Lookup(IndexType index, RouterNode& out) const
+    {
+        auto it = m_nodes.find(index);
+        if (it != m_nodes.end())
+        {
+            out = it->second;
+            return true;
+        }
+
+        if (m_nodes.full())
+        {
+            return false;
+        }
+
+        out = RouterNode();
+        return true;
+    }
+
+    // Only after a successful Lookup. Returns false if the node can't be stored
+    bool Update(IndexType index, const RouterNode& node)
+    {
+        m_nodes[index] = node;
+
+        return true;
+    }
+
+    // Returns false if the open set is full
+    bool Push(const OpenNode& node)
+    {
+        if (m_open_set.full())
+        {
+            return false;
+        }
+        m_open_set.push(node);
+
+        return true;
+    }
+
+    bool Pop(OpenNode& out)
+    {
+        if (!Top(out))
+        {
+            return false;
+        }
+        m_open_set.pop();
+
+        return true;
+    }
+
+    // The lowest f, possibly of a stale entry
+    bool Top(OpenNode& out) const
+    {
+        if (m_open_set.empty())
+        {
+            return false;
+        }
+        out = m_open_set.top();
+
+        return true;
+    }
+
+private:
+    etl::priority_queue<OpenNode, CACHE_SIZE, etl::vector<OpenNode, CACHE_SIZE>, CompareOpenNodes>
+        m_open_set;
+    etl::unordered_map<IndexType, RouterNode, CACHE_SIZE> m_nodes;
+};
+
+
+/**
+ * @brief Node store with one packed word per water cell in the land mask
+ *
+ * Never full, so long routes complete in a single search. A lookup is a rank in the land mask
+ * (a table lookup and a popcount) instead of a hash probe. Each word holds g, the direction to
+ * the parent, the open/closed state and the search generation, so nothing has to be cleared
+ * between the searches: a word from an older generation is an unknown node.
+ *
+ * Uses 4 bytes per water cell plus 4 bytes per 32 cells, allocated from the heap (PSRAM on the
+ * target).
+ */
+class DenseNodeStore
+{
+public:
+    // The searches until the generation wraps, and all the words are cleared
+    static const uint32_t kMaxGeneration;
+
+    DenseNodeStore(std::span<const uint32_t> land_mask, unsigned width);
+
+    void Reset();
+
+    bool Lookup(IndexType index, RouterNode& out) const;
+
+    // Returns false if g is too large for the packed word
+    bool Update(IndexType index, const RouterNode& node);
+
+    bool Push(const OpenNode& node);
+
+    bool Pop(OpenNode& out);
+
+    bool Top(OpenNode& out) const;
+
+private:
+    uint32_t Slot(IndexType index) const;
+
+    const std::span<const uint32_t> m_land_mask;
+    const unsigned m_width;
+
+    // The number of water cells before each land mask word
+    std::vector<uint32_t> m_rank;
+    std::vector<uint32_t> m_cells;
+    // A binary heap, which keeps its capacity between the searches
+    std::vector<OpenNode> m_open_set;
+    uint32_t m_generation {0};
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "node_store.hh"
+#include "tile.hh"
+
+#include <span>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The cluster graph for hierarchical routing, read straight from map.bin
+ *
+ * See RouteClusterHeader. The router connects the start and the goal to the nodes of their
+ * clusters, searches the graph for the crossings to pass, and then the route between them.
+ */
+class RouteClusters
+{
+public:
+    // A node and the cost to (or from) it
+    using NodeCost = std::pair<uint32_t, CostType>;
+
+    struct Bounds
+    {
+        unsigned x0;
+        unsigned y0;
+        unsigned x1; // Exclusive
+        unsigned y1; // Exclusive
+    };
+
+    RouteClusters(const RouteClusterHeader& header, unsigned width, unsigned height);
+
+    unsigned ClusterOf(IndexType index) const;
+
+    // The cells of a cluster, clipped to the land mask
+    Bounds ClusterBounds(unsigned cluster) const;
+
+    // The nodes of a cluster are first..last (exclusive)
+    std::pair<uint32_t, uint32_t> Nodes(unsigned cluster) const;
+
+    IndexType NodeIndex(uint32_t node) const;
+
+    /**
+     * @brief A* over the cluster graph
+     *
+     * @param from the start cell
+     * @param from_costs the nodes of the start cluster, with the cost from the start
+     * @param to the goal cell
+     * @param to_costs the nodes of the goal cluster, with the cost to the goal
+     * @param out the cells to pass, from the start to the goal
+     *
+     * @return false if there is no path
+     */
+    bool FindPath(IndexType from,
+                  std::span<const NodeCost> from_costs,
+                  IndexType to,
+                  std::span<const NodeCost> to_costs,
+                  std::vector<IndexType>& out);
+
+    // The number of nodes expanded by the last FindPath
+    unsigned NodesExpanded() const;
+
+private:
+    CostType Heuristic(IndexType from, IndexType to) const;
+
+    const RouteClusterHeader& m_header;
+    const unsigned m_width;
+    const unsigned m_height;
+
+    std::span<const uint32_t> m_first_node;
+    std::span<const RouteClusterNode> m_nodes;
+    std::span<const RouteClusterEdge> m_edges;
+
+    // The search, with the start and the goal after the graph nodes
+    std::vector<CostType> m_g;
+    std::vector<uint32_t> m_parent;
+    std::vector<uint8_t> m_closed;
+    std::vector<OpenNode> m_open_set;
+    unsigned m_nodes_expanded {0};
+};
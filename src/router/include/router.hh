@@ -1,22 +1,26 @@
 #pragma once
 
+#include "node_store.hh"
+#include "route_clusters.hh"
 #include "tile.hh"
 
-#include <etl/priority_queue.h>
-#include <etl/unordered_map.h>
 #include <etl/vector.h>
-#include <queue>
+#include <memory>
+#include <optional>
 #include <span>
+#include <vector>
 
 constexpr auto kTargetCacheSize = 65535;
 constexpr auto kUnitTestCacheSize = 64;
-constexpr IndexType kInvalidIndex = std::numeric_limits<IndexType>::max();
 
-template <size_t CACHE_SIZE>
+/**
+ * @brief A* over the water cells of the land mask
+ *
+ * @tparam NodeStore HashNodeStore or DenseNodeStore
+ */
+template <typename NodeStore>
 class Router
 {
-    static_assert(CACHE_SIZE <= std::numeric_limits<uint16_t>::max());
-
 public:
     struct Stats
     {
@@ -24,17 +28,42 @@ public:
         {
             partial_paths = 0;
             nodes_expanded = 0;
+            abstract_nodes_expanded = 0;
         }
 
         unsigned partial_paths {0};
         unsigned nodes_expanded {0};
+        // In the cluster graph, for hierarchical routes
+        unsigned abstract_nodes_expanded {0};
     };
 
-    Router(std::span<const uint32_t> land_mask, unsigned height, unsigned width);
+    /**
+     * @brief Construct a new router
+     *
+     * @param land_mask the land mask, one bit per cell
+     * @param height the number of rows
+     * @param width the number of cells per row
+     * @param clusters the cluster graph from map.bin, for hierarchical routing between clusters
+     */
+    Router(std::span<const uint32_t> land_mask,
+           unsigned height,
+           unsigned width,
+           const RouteClusterHeader* clusters = nullptr);
 
     std::span<const IndexType> CalculateRoute(Point from, Point to);
     std::span<const IndexType> CalculateRoute(IndexType from, IndexType to);
 
+    /**
+     * @brief Search from both the start and the goal, until the frontiers meet
+     *
+     * Allocates a second node store for the search from the goal, which is freed when disabled.
+     * Usually expands fewer nodes than the search from the start only, for routes of about the
+     * same cost.
+     *
+     * @param enable true to enable
+     */
+    void SetBidirectional(bool enable);
+
     // For unit tests
     Stats GetStats() const;
 
@@ -46,75 +75,38 @@ private:
         kMaxNodesReached,
     };
 
-    enum class NodeState : uint8_t
-    {
-        kUnknown,
-        kOpen,
-        kClosed,
-    };
-
     enum class NeighborType : uint8_t
     {
         kIgnoreLand,
         kAll,
     };
 
-    struct Node
-    {
-        Node()
-            : g(0)
-            , f(0)
-            , parent(nullptr)
-            , state(NodeState::kUnknown)
-        {
-        }
+    // Appends to m_result
+    bool CalculateFlatRoute(IndexType from, IndexType to);
 
-        void Close()
-        {
-            state = NodeState::kClosed;
-        }
+    bool CalculateHierarchicalRoute(IndexType from, IndexType to);
 
-        void Open()
-        {
-            state = NodeState::kOpen;
-        }
+    // Dijkstra inside the cluster of start, to (or with reverse, from) the cluster nodes
+    void ClusterCosts(IndexType start, bool reverse, std::vector<RouteClusters::NodeCost>& out);
 
-        bool IsOpen() const
-        {
-            return state == NodeState::kOpen;
-        }
-
-        bool IsClosed() const
-        {
-            return state == NodeState::kClosed;
-        }
-
-        Node* parent;
-        CostType g;
-        CostType f;
-        IndexType index;
-        NodeState state;
-    };
+    AstarResult RunAstar(IndexType from, IndexType to);
 
-    struct CompareNodePointers
-    {
-        bool operator()(const Node* lhs, const Node* rhs) const
-        {
-            return lhs->f > rhs->f;
-        }
-    };
+    AstarResult RunBidirectionalAstar(IndexType from, IndexType to);
 
-    AstarResult RunAstar(IndexType from, IndexType to);
+    // The direction changes from the goal back to the start, through meet
+    void ProduceBidirectionalResult(IndexType meet);
 
-    Node* GetNode(IndexType index);
+    // Without the bonus for going straight
+    CostType StepCost(IndexType from, IndexType to) const;
 
     etl::vector<IndexType, 8> Neighbors(IndexType index, NeighborType include_neighbors) const;
 
     CostType Heuristic(IndexType from, IndexType to);
 
-    void ProduceResult(const Node* cur);
+    void ProduceResult(IndexType cur);
 
-    bool AdjacentToLand(const Node* node) const;
+    // The distance to land for each cell, counted in cells (land is 0, next to land 1)
+    void CalculateClearance();
 
     IndexType FindNearestWater(IndexType from) const;
 
@@ -122,9 +114,17 @@ private:
     const unsigned m_height;
     const unsigned m_width;
 
-    etl::priority_queue<Node*, CACHE_SIZE, etl::vector<Node*, CACHE_SIZE>, CompareNodePointers>
-        m_open_set;
-    etl::unordered_map<IndexType, Node, CACHE_SIZE> m_nodes;
+    NodeStore m_nodes;
+    // For the search from the goal, where the parent is the next cell towards the goal
+    std::unique_ptr<NodeStore> m_backward_nodes;
+    std::vector<uint8_t> m_clearance;
+
+    std::optional<RouteClusters> m_clusters;
+    std::vector<RouteClusters::NodeCost> m_from_costs;
+    std::vector<RouteClusters::NodeCost> m_to_costs;
+    std::vector<IndexType> m_waypoints;
+    std::vector<CostType> m_cluster_costs;
+    std::vector<OpenNode> m_cluster_open_set;
 
     std::vector<IndexType> m_current_result;
     std::vector<IndexType> m_result;
@@ -0,0 +1,161 @@
+#include "node_store.hh"
+
+#include "route_utils.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace
+{
+
+// The packed word: g, the parent direction, the closed bit and the generation
+constexpr auto kGBits = 22;
+constexpr auto kParentShift = kGBits;
+constexpr auto kClosedShift = kParentShift + 4;
+constexpr auto kGenerationShift = kClosedShift + 1;
+
+constexpr uint32_t kMaxG = (1u << kGBits) - 1;
+
+// (dy + 1) * 3 + (dx + 1) to the parent, the middle (the node itself) for no parent
+constexpr uint32_t kNoParent = 4;
+
+// Enough for most routes, grows if needed
+constexpr auto kInitialOpenSetSize = 16 * 1024;
+
+} // namespace
+
+const uint32_t DenseNodeStore::kMaxGeneration = (1u << (32 - kGenerationShift)) - 1;
+
+DenseNodeStore::DenseNodeStore(std::span<const uint32_t> land_mask, unsigned width)
+    : m_land_mask(land_mask)
+    , m_width(width)
+{
+    auto water = 0u;
+
+    m_rank.resize(land_mask.size());
+    for (auto i = 0u; i < land_mask.size(); i++)
+    {
+        m_rank[i] = water;
+        water += std::popcount(~land_mask[i]);
+    }
+
+    m_cells.resize(water);
+    m_open_set.reserve(kInitialOpenSetSize);
+}
+
+void
+DenseNodeStore::Reset()
+{
+    m_open_set.clear();
+
+    m_generation++;
+    if (m_generation > kMaxGeneration)
+    {
+        // Wrapped, so the old generations have to go. Generation 0 is never used
+        std::ranges::fill(m_cells, 0);
+        m_generation = 1;
+    }
+}
+
+bool
+DenseNodeStore::Lookup(IndexType index, RouterNode& out) const
+{
+    auto cell = m_cells[Slot(index)];
+
+    if (cell >> kGenerationShift != m_generation)
+    {
+        out = RouterNode();
+        return true;
+    }
+
+    auto parent = (cell >> kParentShift) & 0xf;
+
+    out.g = cell & kMaxG;
+    out.state = (cell >> kClosedShift) & 1 ? NodeState::kClosed : NodeState::kOpen;
+    out.parent = kInvalidIndex;
+    if (parent != kNoParent)
+    {
+        int dx = parent % 3 - 1;
+        int dy = parent / 3 - 1;
+
+        out.parent = index + dy * static_cast<int>(m_width) + dx;
+    }
+
+    return true;
+}
+
+bool
+DenseNodeStore::Update(IndexType index, const RouterNode& node)
+{
+    assert(node.state != NodeState::kUnknown);
+
+    if (node.g > kMaxG)
+    {
+        // Does not fit in the word
+        return false;
+    }
+
+    auto parent = kNoParent;
+    if (node.parent != kInvalidIndex)
+    {
+        int dx = static_cast<int>(node.parent % m_width) - static_cast<int>(index % m_width);
+        int dy = static_cast<int>(node.parent / m_width) - static_cast<int>(index / m_width);
+
+        assert(dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1);
+        parent = (dy + 1) * 3 + (dx + 1);
+    }
+
+    m_cells[Slot(index)] = node.g | parent << kParentShift |
+                           (node.state == NodeState::kClosed) << kClosedShift |
+                           m_generation << kGenerationShift;
+
+    return true;
+}
+
+bool
+DenseNodeStore::Push(const OpenNode& node)
+{
+    m_open_set.push_back(node);
+    std::ranges::push_heap(m_open_set, CompareOpenNodes());
+
+    return true;
+}
+
+bool
+DenseNodeStore::Pop(OpenNode& out)
+{
+    if (m_open_set.empty())
+    {
+        return false;
+    }
+
+    std::ranges::pop_heap(m_open_set, CompareOpenNodes());
+    out = m_open_set.back();
+    m_open_set.pop_back();
+
+    return true;
+}
+
+bool
+DenseNodeStore::Top(OpenNode& out) const
+{
+    if (m_open_set.empty())
+    {
+        return false;
+    }
+    out = m_open_set.front();
+
+    return true;
+}
+
+uint32_t
+DenseNodeStore::Slot(IndexType index) const
+{
+    assert(IsWater(m_land_mask, index));
+
+    auto word = index / 32;
+    auto below = (1u << (index % 32)) - 1;
+
+    return m_rank[word] + std::popcount(~m_land_mask[word] & below);
+}
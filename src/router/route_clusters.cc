@@ -0,0 +1,170 @@
+#include "route_clusters.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+RouteClusters::RouteClusters(const RouteClusterHeader& header, unsigned width, unsigned height)
+    : m_header(header)
+    , m_width(width)
+    , m_height(height)
+{
+    auto clusters = header.cluster_row_size * header.cluster_rows;
+    auto first_node = reinterpret_cast<const uint32_t*>(&header + 1);
+    auto nodes = reinterpret_cast<const RouteClusterNode*>(first_node + clusters + 1);
+    auto edges = reinterpret_cast<const RouteClusterEdge*>(nodes + header.node_count + 1);
+
+    m_first_node = {first_node, clusters + 1};
+    m_nodes = {nodes, header.node_count + 1};
+    m_edges = {edges, header.edge_count};
+
+    m_g.resize(header.node_count + 2);
+    m_parent.resize(header.node_count + 2);
+    m_closed.resize(header.node_count + 2);
+}
+
+unsigned
+RouteClusters::ClusterOf(IndexType index) const
+{
+    auto x = index % m_width;
+    auto y = index / m_width;
+
+    return (y / m_header.cluster_size) * m_header.cluster_row_size + x / m_header.cluster_size;
+}
+
+RouteClusters::Bounds
+RouteClusters::ClusterBounds(unsigned cluster) const
+{
+    auto x0 = (cluster % m_header.cluster_row_size) * m_header.cluster_size;
+    auto y0 = (cluster / m_header.cluster_row_size) * m_header.cluster_size;
+
+    return {x0,
+            y0,
+            std::min(x0 + m_header.cluster_size, m_width),
+            std::min(y0 + m_header.cluster_size, m_height)};
+}
+
+std::pair<uint32_t, uint32_t>
+RouteClusters::Nodes(unsigned cluster) const
+{
+    if (cluster + 1 >= m_first_node.size())
+    {
+        return {0, 0};
+    }
+
+    return {m_first_node[cluster], m_first_node[cluster + 1]};
+}
+
+IndexType
+RouteClusters::NodeIndex(uint32_t node) const
+{
+    return m_nodes[node].index;
+}
+
+bool
+RouteClusters::FindPath(IndexType from,
+                        std::span<const NodeCost> from_costs,
+                        IndexType to,
+                        std::span<const NodeCost> to_costs,
+                        std::vector<IndexType>& out)
+{
+    const uint32_t start = m_header.node_count;
+    const uint32_t goal = start + 1;
+    const auto [first_goal_node, last_goal_node] = Nodes(ClusterOf(to));
+
+    auto index_of = [this, start, goal, from, to](uint32_t node) {
+        return node == start ? from : node == goal ? to : m_nodes[node].index;
+    };
+
+    std::ranges::fill(m_g, std::numeric_limits<CostType>::max());
+    std::ranges::fill(m_closed, 0);
+    m_open_set.clear();
+    m_nodes_expanded = 0;
+
+    auto relax = [this, &index_of, to](uint32_t cur, uint32_t node, CostType cost) {
+        auto g = m_g[cur] + cost;
+
+        if (g < m_g[node])
+        {
+            m_g[node] = g;
+            m_parent[node] = cur;
+            m_open_set.push_back({g + Heuristic(index_of(node), to), node});
+            std::ranges::push_heap(m_open_set, CompareOpenNodes());
+        }
+    };
+
+    m_g[start] = 0;
+    m_open_set.push_back({Heuristic(from, to), start});
+
+    while (!m_open_set.empty())
+    {
+        std::ranges::pop_heap(m_open_set, CompareOpenNodes());
+        auto cur = m_open_set.back().index;
+        m_open_set.pop_back();
+
+        if (m_closed[cur])
+        {
+            continue;
+        }
+        m_closed[cur] = 1;
+        m_nodes_expanded++;
+
+        if (cur == goal)
+        {
+            out.clear();
+            for (auto node = goal; node != start; node = m_parent[node])
+            {
+                out.push_back(index_of(node));
+            }
+            out.push_back(from);
+            std::ranges::reverse(out);
+
+            return true;
+        }
+
+        if (cur == start)
+        {
+            for (auto [node, cost] : from_costs)
+            {
+                relax(cur, node, cost);
+            }
+            continue;
+        }
+
+        for (auto i = m_nodes[cur].first_edge; i < m_nodes[cur + 1].first_edge; i++)
+        {
+            relax(cur, m_edges[i].to, m_edges[i].cost);
+        }
+
+        if (cur >= first_goal_node && cur < last_goal_node)
+        {
+            for (auto [node, cost] : to_costs)
+            {
+                if (node == cur)
+                {
+                    relax(cur, goal, cost);
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+unsigned
+RouteClusters::NodesExpanded() const
+{
+    return m_nodes_expanded;
+}
+
+CostType
+RouteClusters::Heuristic(IndexType from, IndexType to) const
+{
+    // Same as the router
+    const auto D = 2;
+    const auto D2 = 3;
+    const auto dx = std::abs(static_cast<int>(from % m_width) - static_cast<int>(to % m_width));
+    const auto dy = std::abs(static_cast<int>(from / m_width) - static_cast<int>(to / m_width));
+
+    return D * (dx + dy) + (D2 - 2 * D) * std::min(dx, dy);
+}
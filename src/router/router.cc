@@ -2,17 +2,40 @@
 
 #include "route_utils.hh"
 
-template <size_t CACHE_SIZE>
-Router<CACHE_SIZE>::Router(std::span<const uint32_t> land_mask, unsigned height, unsigned width)
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace
+{
+
+// The extra cost to move into a cell, by its distance to land. Keeps the routes mid-channel
+constexpr auto kClearanceCost = std::array<CostType, 4> {0, 8, 3, 1};
+
+} // namespace
+
+template <typename NodeStore>
+Router<NodeStore>::Router(std::span<const uint32_t> land_mask,
+                          unsigned height,
+                          unsigned width,
+                          const RouteClusterHeader* clusters)
     : m_land_mask(land_mask)
     , m_height(height)
     , m_width(width)
+    , m_nodes(land_mask, width)
 {
+    CalculateClearance();
+
+    if (clusters)
+    {
+        m_clusters.emplace(*clusters, width, height);
+        m_cluster_costs.resize(clusters->cluster_size * clusters->cluster_size);
+    }
 }
 
-template <size_t CACHE_SIZE>
+template <typename NodeStore>
 std::span<const IndexType>
-Router<CACHE_SIZE>::CalculateRoute(Point from_point, Point to_point)
+Router<NodeStore>::CalculateRoute(Point from_point, Point to_point)
 {
     auto from = PointToLandIndex(from_point, m_width);
     auto to = PointToLandIndex(to_point, m_width);
@@ -20,9 +43,9 @@ Router<CACHE_SIZE>::CalculateRoute(Point from_point, Point to_point)
     return CalculateRoute(from, to);
 }
 
-template <size_t CACHE_SIZE>
+template <typename NodeStore>
 std::span<const IndexType>
-Router<CACHE_SIZE>::CalculateRoute(IndexType from, IndexType to)
+Router<NodeStore>::CalculateRoute(IndexType from, IndexType to)
 {
     if (!IsWater(m_land_mask, from))
     {
@@ -36,12 +59,41 @@ Router<CACHE_SIZE>::CalculateRoute(IndexType from, IndexType to)
     m_stats.Reset();
     m_result.clear();
 
+    if (!IsWater(m_land_mask, from) || !IsWater(m_land_mask, to))
+    {
+        // No water nearby
+        return {};
+    }
+
+    if (m_clusters && m_clusters->ClusterOf(from) != m_clusters->ClusterOf(to))
+    {
+        if (CalculateHierarchicalRoute(from, to))
+        {
+            return m_result;
+        }
+
+        // Fall back to the full search, e.g., for passages which only cross a cluster corner
+        m_result.clear();
+    }
+
+    if (CalculateFlatRoute(from, to))
+    {
+        return m_result;
+    }
+
+    return {};
+}
+
+template <typename NodeStore>
+bool
+Router<NodeStore>::CalculateFlatRoute(IndexType from, IndexType to)
+{
     for (auto i = 0; i < 100; i++)
     {
-        auto rc = RunAstar(from, to);
+        auto rc = m_backward_nodes ? RunBidirectionalAstar(from, to) : RunAstar(from, to);
         if (rc == Router::AstarResult::kNoPath)
         {
-            return {};
+            return false;
         }
         else
         {
@@ -64,7 +116,7 @@ Router<CACHE_SIZE>::CalculateRoute(IndexType from, IndexType to)
 
             if (rc == Router::AstarResult::kPathFound)
             {
-                return m_result;
+                return true;
             }
             else
             {
@@ -76,95 +128,203 @@ Router<CACHE_SIZE>::CalculateRoute(IndexType from, IndexType to)
         m_stats.partial_paths++;
     }
 
-    return {};
+    return false;
 }
 
-template <size_t CACHE_SIZE>
-Router<CACHE_SIZE>::AstarResult
-Router<CACHE_SIZE>::RunAstar(IndexType from, IndexType to)
+template <typename NodeStore>
+void
+Router<NodeStore>::SetBidirectional(bool enable)
 {
-    m_current_result.clear();
-    m_open_set.clear();
-    m_nodes.clear();
+    if (!enable)
+    {
+        m_backward_nodes = nullptr;
+    }
+    else if (!m_backward_nodes)
+    {
+        m_backward_nodes = std::make_unique<NodeStore>(m_land_mask, m_width);
+    }
+}
+
+template <typename NodeStore>
+bool
+Router<NodeStore>::CalculateHierarchicalRoute(IndexType from, IndexType to)
+{
+    ClusterCosts(from, false, m_from_costs);
+    ClusterCosts(to, true, m_to_costs);
 
-    auto p = GetNode(from);
+    auto found = m_clusters->FindPath(from, m_from_costs, to, m_to_costs, m_waypoints);
+    m_stats.abstract_nodes_expanded += m_clusters->NodesExpanded();
+    if (!found)
+    {
+        return false;
+    }
 
-    p->f = p->g + Heuristic(from, to); /* g+h */
-    p->parent = nullptr;
+    // Refine, one cluster (or cluster border) at a time
+    for (auto i = 1u; i < m_waypoints.size(); i++)
+    {
+        if (m_waypoints[i - 1] == m_waypoints[i])
+        {
+            continue;
+        }
+        if (!CalculateFlatRoute(m_waypoints[i - 1], m_waypoints[i]))
+        {
+            return false;
+        }
+    }
 
-    m_open_set.push(p);
+    return true;
+}
+
+template <typename NodeStore>
+void
+Router<NodeStore>::ClusterCosts(IndexType start,
+                                bool reverse,
+                                std::vector<RouteClusters::NodeCost>& out)
+{
+    const auto cluster = m_clusters->ClusterOf(start);
+    const auto bounds = m_clusters->ClusterBounds(cluster);
+    const auto cluster_width = bounds.x1 - bounds.x0;
+
+    auto local = [&bounds, cluster_width, this](IndexType index) {
+        return (index / m_width - bounds.y0) * cluster_width + index % m_width - bounds.x0;
+    };
+
+    std::ranges::fill(m_cluster_costs, std::numeric_limits<CostType>::max());
+    m_cluster_open_set.clear();
+
+    m_cluster_costs[local(start)] = 0;
+    m_cluster_open_set.push_back({0, start});
+    while (!m_cluster_open_set.empty())
+    {
+        std::ranges::pop_heap(m_cluster_open_set, CompareOpenNodes());
+        auto [cost, cur] = m_cluster_open_set.back();
+        m_cluster_open_set.pop_back();
+
+        if (cost > m_cluster_costs[local(cur)])
+        {
+            continue;
+        }
+
+        for (auto neighbor : Neighbors(cur, NeighborType::kIgnoreLand))
+        {
+            auto x = neighbor % m_width;
+            auto y = neighbor / m_width;
+
+            if (x < bounds.x0 || x >= bounds.x1 || y < bounds.y0 || y >= bounds.y1)
+            {
+                continue;
+            }
+
+            m_stats.nodes_expanded++;
+            auto new_cost =
+                cost + (reverse ? StepCost(neighbor, cur) : StepCost(cur, neighbor));
+            if (new_cost < m_cluster_costs[local(neighbor)])
+            {
+                m_cluster_costs[local(neighbor)] = new_cost;
+                m_cluster_open_set.push_back({new_cost, neighbor});
+                std::ranges::push_heap(m_cluster_open_set, CompareOpenNodes());
+            }
+        }
+    }
+
+    out.clear();
+    auto [first, last] = m_clusters->Nodes(cluster);
+    for (auto node = first; node < last; node++)
+    {
+        auto cost = m_cluster_costs[local(m_clusters->NodeIndex(node))];
+
+        if (cost != std::numeric_limits<CostType>::max())
+        {
+            out.push_back({node, cost});
+        }
+    }
+}
+
+template <typename NodeStore>
+Router<NodeStore>::AstarResult
+Router<NodeStore>::RunAstar(IndexType from, IndexType to)
+{
+    m_current_result.clear();
+    m_nodes.Reset();
+
+    m_nodes.Update(from, {.g = 0, .parent = kInvalidIndex, .state = NodeState::kOpen});
+
+    m_nodes.Push({Heuristic(from, to), from}); /* g+h */
 
     /* While there are nodes in the Open set */
-    while (!m_open_set.empty())
+    OpenNode top;
+    while (m_nodes.Pop(top))
     {
-        auto cur = m_open_set.top();
+        auto cur_index = top.index;
+        RouterNode cur;
 
-        m_open_set.pop();
+        m_nodes.Lookup(cur_index, cur);
+        if (cur.state == NodeState::kClosed)
+        {
+            // A stale entry, the node has already been expanded with a better g
+            continue;
+        }
 
         /* We found a path! */
-        if (cur->index == to)
+        if (cur_index == to)
         {
-            ProduceResult(cur);
+            ProduceResult(cur_index);
 
             return Router::AstarResult::kPathFound;
         }
 
         auto parent_direction = Vector::Standstill();
 
-        if (cur->parent)
+        if (cur.parent != kInvalidIndex)
         {
-            parent_direction = IndexPairToDirection(cur->parent->index, cur->index, m_width);
+            parent_direction = IndexPairToDirection(cur.parent, cur_index, m_width);
         }
 
+        cur.state = NodeState::kClosed;
+        m_nodes.Update(cur_index, cur);
+
         /* Iterate over UP, DOWN, LEFT and RIGHT */
-        for (auto neighbor_index : Neighbors(cur->index, NeighborType::kIgnoreLand))
+        for (auto neighbor_index : Neighbors(cur_index, NeighborType::kIgnoreLand))
         {
-            auto neighbor_node = GetNode(neighbor_index);
+            RouterNode neighbor_node;
 
             m_stats.nodes_expanded++;
-            if (!neighbor_node)
+            if (!m_nodes.Lookup(neighbor_index, neighbor_node))
             {
-                ProduceResult(cur);
+                ProduceResult(cur_index);
 
                 return Router::AstarResult::kMaxNodesReached;
             }
 
-            const auto direction = IndexPairToDirection(cur->index, neighbor_index, m_width);
-            const auto is_diagonal = (neighbor_index % m_width != cur->index % m_width) &&
-                                     (neighbor_index / m_width != cur->index / m_width);
-            auto cost = is_diagonal ? 6 : 4;
+            const auto direction = IndexPairToDirection(cur_index, neighbor_index, m_width);
+            auto cost = StepCost(cur_index, neighbor_index);
 
             if (direction == parent_direction)
             {
                 // Favor straight lines
                 cost -= 1;
             }
+            auto newg = cur.g + cost;
 
-            // If there's land in this direction, add an extra cost to it to keep the path from land
-            if (AdjacentToLand(neighbor_node))
-            {
-                cost += 8;
-            }
-            auto newg = cur->g + cost;
-
-            if ((neighbor_node->IsOpen() || neighbor_node->IsClosed()) && neighbor_node->g <= newg)
+            if (neighbor_node.state != NodeState::kUnknown && neighbor_node.g <= newg)
             {
                 // We have a better value or this is not valid
                 continue;
             }
 
-            neighbor_node->parent = cur;
-            neighbor_node->g = newg;
-            neighbor_node->f = neighbor_node->g + Heuristic(neighbor_index, to); // g+h
+            neighbor_node.parent = cur_index;
+            neighbor_node.g = newg;
+            neighbor_node.state = NodeState::kOpen;
 
-            if (!neighbor_node->IsOpen())
+            // Full, or g too large for the node store, so continue from a partial path
+            if (!m_nodes.Update(neighbor_index, neighbor_node) ||
+                !m_nodes.Push({newg + Heuristic(neighbor_index, to), neighbor_index})) // g+h
             {
-                m_open_set.push(neighbor_node);
-                neighbor_node->Open();
+                ProduceResult(cur_index);
+
+                return Router::AstarResult::kMaxNodesReached;
             }
         }
-
-        cur->Close();
     }
 
     /* There was no path */
@@ -172,34 +332,165 @@ Router<CACHE_SIZE>::RunAstar(IndexType from, IndexType to)
 }
 
 
-template <size_t CACHE_SIZE>
-Router<CACHE_SIZE>::Node*
-Router<CACHE_SIZE>::GetNode(IndexType index)
+template <typename NodeStore>
+Router<NodeStore>::AstarResult
+Router<NodeStore>::RunBidirectionalAstar(IndexType from, IndexType to)
 {
-    auto it = m_nodes.find(index);
-    if (it != m_nodes.end())
-    {
-        return &it->second;
-    }
+    auto& backward_nodes = *m_backward_nodes;
+
+    m_current_result.clear();
+    m_nodes.Reset();
+    backward_nodes.Reset();
+
+    // The average of the heuristics to the goal and from the start, negated backwards, so that
+    // the frontiers can be compared. Doubled and offset to stay integral and positive
+    const auto h = Heuristic(from, to);
+    auto key = [this, from, to, h](bool is_forward, CostType g, IndexType index) {
+        auto h_to = static_cast<int>(Heuristic(index, to));
+        auto h_from = static_cast<int>(Heuristic(from, index));
+
+        return static_cast<CostType>(2 * g + (is_forward ? h_to - h_from : h_from - h_to) + h);
+    };
 
-    if (m_nodes.full())
+    m_nodes.Update(from, {.g = 0, .parent = kInvalidIndex, .state = NodeState::kOpen});
+    m_nodes.Push({key(true, 0, from), from});
+    backward_nodes.Update(to, {.g = 0, .parent = kInvalidIndex, .state = NodeState::kOpen});
+    backward_nodes.Push({key(false, 0, to), to});
+
+    auto best = std::numeric_limits<CostType>::max();
+    auto meet = kInvalidIndex;
+    auto forward = true;
+
+    while (true)
     {
-        return nullptr;
+        OpenNode forward_top;
+        OpenNode backward_top;
+
+        if (!m_nodes.Top(forward_top) || !backward_nodes.Top(backward_top))
+        {
+            // One of the searches has been exhausted
+            break;
+        }
+        // The keys of a cell add up to twice the cost through it (plus the offsets), and a
+        // route can be one cheaper than that when going straight through the meeting cell
+        if (best != std::numeric_limits<CostType>::max() &&
+            forward_top.f + backward_top.f >= 2 * (best + 1) + 2 * h)
+        {
+            // Nothing left in the frontiers can give a cheaper route
+            break;
+        }
+
+        const auto is_forward = forward;
+        auto& nodes = is_forward ? m_nodes : backward_nodes;
+        auto& other_nodes = is_forward ? backward_nodes : m_nodes;
+        OpenNode top;
+        RouterNode cur;
+
+        // Alternate between the searches
+        nodes.Pop(top);
+        forward = !forward;
+
+        auto cur_index = top.index;
+        nodes.Lookup(cur_index, cur);
+        if (cur.state == NodeState::kClosed)
+        {
+            continue;
+        }
+
+        // Towards the goal, i.e., from the parent in the forward search, and to it backwards
+        auto parent_direction = Vector::Standstill();
+        if (cur.parent != kInvalidIndex)
+        {
+            parent_direction = is_forward ? IndexPairToDirection(cur.parent, cur_index, m_width)
+                                          : IndexPairToDirection(cur_index, cur.parent, m_width);
+        }
+
+        cur.state = NodeState::kClosed;
+        nodes.Update(cur_index, cur);
+
+        for (auto neighbor_index : Neighbors(cur_index, NeighborType::kIgnoreLand))
+        {
+            RouterNode neighbor_node;
+            RouterNode other_node;
+
+            m_stats.nodes_expanded++;
+            if (!nodes.Lookup(neighbor_index, neighbor_node) ||
+                !other_nodes.Lookup(neighbor_index, other_node))
+            {
+                // Full, so merge partial paths instead
+                return RunAstar(from, to);
+            }
+
+            // The step is neighbor -> cur when searching backwards, so the cost and the bonus
+            // for going straight are the same as from the start
+            const auto direction = is_forward
+                                       ? IndexPairToDirection(cur_index, neighbor_index, m_width)
+                                       : IndexPairToDirection(neighbor_index, cur_index, m_width);
+            auto cost = is_forward ? StepCost(cur_index, neighbor_index)
+                                   : StepCost(neighbor_index, cur_index);
+
+            if (direction == parent_direction)
+            {
+                // Favor straight lines
+                cost -= 1;
+            }
+            auto newg = cur.g + cost;
+
+            if (neighbor_node.state == NodeState::kUnknown || newg < neighbor_node.g)
+            {
+                neighbor_node.parent = cur_index;
+                neighbor_node.g = newg;
+                neighbor_node.state = NodeState::kOpen;
+                if (!nodes.Update(neighbor_index, neighbor_node) ||
+                    !nodes.Push({key(is_forward, newg, neighbor_index), neighbor_index}))
+                {
+                    return RunAstar(from, to);
+                }
+            }
+
+            if (other_node.state == NodeState::kUnknown)
+            {
+                continue;
+            }
+
+            // Reached from both sides. The bonus for going straight through the meeting cell is
+            // in neither of the searches
+            auto route_cost = neighbor_node.g + other_node.g;
+            if (neighbor_node.parent != kInvalidIndex && other_node.parent != kInvalidIndex)
+            {
+                auto forward_parent = is_forward ? neighbor_node.parent : other_node.parent;
+                auto backward_parent = is_forward ? other_node.parent : neighbor_node.parent;
+
+                if (IndexPairToDirection(forward_parent, neighbor_index, m_width) ==
+                    IndexPairToDirection(neighbor_index, backward_parent, m_width))
+                {
+                    route_cost -= 1;
+                }
+            }
+
+            if (route_cost < best)
+            {
+                best = route_cost;
+                meet = neighbor_index;
+            }
+        }
     }
 
-    auto [insert_it, ok] = m_nodes.insert({index, Node()});
-    if (!ok)
+    if (meet == kInvalidIndex)
     {
-        return nullptr;
+        /* There was no path */
+        return Router::AstarResult::kNoPath;
     }
-    insert_it->second.index = index;
-    return &insert_it->second;
+
+    ProduceBidirectionalResult(meet);
+
+    return Router::AstarResult::kPathFound;
 }
 
 
-template <size_t CACHE_SIZE>
+template <typename NodeStore>
 etl::vector<IndexType, 8>
-Router<CACHE_SIZE>::Neighbors(IndexType index, NeighborType include_neighbors) const
+Router<NodeStore>::Neighbors(IndexType index, NeighborType include_neighbors) const
 {
     etl::vector<IndexType, 8> neighbors;
 
@@ -243,9 +534,9 @@ Router<CACHE_SIZE>::Neighbors(IndexType index, NeighborType include_neighbors) c
 }
 
 
-template <size_t CACHE_SIZE>
+template <typename NodeStore>
 CostType
-Router<CACHE_SIZE>::Heuristic(IndexType from, IndexType to)
+Router<NodeStore>::Heuristic(IndexType from, IndexType to)
 {
     int from_x = from % m_width;
     int from_y = from / m_width;
@@ -268,24 +559,80 @@ Router<CACHE_SIZE>::Heuristic(IndexType from, IndexType to)
     return D * (dx + dy) + (D2 - 2 * D) * std::min(dx, dy);
 }
 
-template <size_t CACHE_SIZE>
-bool
-Router<CACHE_SIZE>::AdjacentToLand(const Node* node) const
+template <typename NodeStore>
+CostType
+Router<NodeStore>::StepCost(IndexType from, IndexType to) const
+{
+    const auto is_diagonal = (to % m_width != from % m_width) && (to / m_width != from / m_width);
+    auto cost = is_diagonal ? 6 : 4;
+
+    // Keep the path from land
+    auto clearance = m_clearance[to];
+    if (clearance < kClearanceCost.size())
+    {
+        cost += kClearanceCost[clearance];
+    }
+
+    return cost;
+}
+
+template <typename NodeStore>
+void
+Router<NodeStore>::CalculateClearance()
 {
-    for (auto neighbor_index : Neighbors(node->index, NeighborType::kAll))
+    constexpr uint8_t kMaxClearance = std::numeric_limits<uint8_t>::max();
+
+    m_clearance.resize(m_width * m_height);
+    for (auto i = 0u; i < m_clearance.size(); i++)
     {
-        if (!IsWater(m_land_mask, neighbor_index))
+        m_clearance[i] = IsWater(m_land_mask, i) ? kMaxClearance : 0;
+    }
+
+    // Chessboard distance, like the neighbors, in two passes: From the top left with the
+    // neighbors above and to the left, and back from the bottom right with the others
+    auto relax = [this](unsigned x, unsigned y, int dx, int dy) {
+        auto& cur = m_clearance[y * m_width + x];
+        int nx = x + dx;
+        int ny = y + dy;
+
+        if (cur == 0 || nx < 0 || nx >= static_cast<int>(m_width) || ny < 0 ||
+            ny >= static_cast<int>(m_height))
         {
-            return true;
+            return;
         }
-    }
 
-    return false;
+        auto neighbor = m_clearance[ny * m_width + nx];
+        if (neighbor < kMaxClearance)
+        {
+            cur = std::min<uint8_t>(cur, neighbor + 1);
+        }
+    };
+
+    for (auto y = 0u; y < m_height; y++)
+    {
+        for (auto x = 0u; x < m_width; x++)
+        {
+            relax(x, y, -1, -1);
+            relax(x, y, 0, -1);
+            relax(x, y, 1, -1);
+            relax(x, y, -1, 0);
+        }
+    }
+    for (auto y = m_height; y-- > 0;)
+    {
+        for (auto x = m_width; x-- > 0;)
+        {
+            relax(x, y, 1, 1);
+            relax(x, y, 0, 1);
+            relax(x, y, -1, 1);
+            relax(x, y, 1, 0);
+        }
+    }
 }
 
-template <size_t CACHE_SIZE>
+template <typename NodeStore>
 IndexType
-Router<CACHE_SIZE>::FindNearestWater(IndexType from) const
+Router<NodeStore>::FindNearestWater(IndexType from) const
 {
     constexpr auto kLimit = 16;
     auto point = LandIndexToPoint(from, m_width);
@@ -318,42 +665,85 @@ Router<CACHE_SIZE>::FindNearestWater(IndexType from) const
     return from;
 }
 
-template <size_t CACHE_SIZE>
+template <typename NodeStore>
 void
-Router<CACHE_SIZE>::ProduceResult(const Node* cur)
+Router<NodeStore>::ProduceResult(IndexType cur)
 {
     auto last_direction = Vector::Standstill();
+    RouterNode node;
 
-    while (cur->parent)
+    m_nodes.Lookup(cur, node);
+    while (node.parent != kInvalidIndex)
     {
-        auto next_direction = IndexPairToDirection(cur->index, cur->parent->index, m_width);
+        auto parent = node.parent;
+        auto next_direction = IndexPairToDirection(cur, parent, m_width);
 
         if (next_direction != last_direction)
         {
             // Can happen if multiple paths are merged
-            if (m_current_result.size() > 0 && m_current_result.back() == cur->index)
+            if (m_current_result.size() > 0 && m_current_result.back() == cur)
             {
                 m_current_result.pop_back();
             }
 
-            m_current_result.push_back(cur->index);
+            m_current_result.push_back(cur);
         }
-        cur = cur->parent;
-        if (!cur->parent)
+        cur = parent;
+        m_nodes.Lookup(cur, node);
+        if (node.parent == kInvalidIndex)
         {
             // Always push the last
-            m_current_result.push_back(cur->index);
+            m_current_result.push_back(cur);
         }
         last_direction = next_direction;
     }
 }
 
-template <size_t CACHE_SIZE>
-Router<CACHE_SIZE>::Stats
-Router<CACHE_SIZE>::GetStats() const
+template <typename NodeStore>
+void
+Router<NodeStore>::ProduceBidirectionalResult(IndexType meet)
+{
+    std::vector<IndexType> path;
+    RouterNode node;
+
+    // From the goal to the meeting cell, and then back to the start
+    for (auto cur = meet; cur != kInvalidIndex; cur = node.parent)
+    {
+        path.push_back(cur);
+        m_backward_nodes->Lookup(cur, node);
+    }
+    std::ranges::reverse(path);
+
+    m_nodes.Lookup(meet, node);
+    for (auto cur = node.parent; cur != kInvalidIndex; cur = node.parent)
+    {
+        path.push_back(cur);
+        m_nodes.Lookup(cur, node);
+    }
+
+    // Only the direction changes, like ProduceResult
+    m_current_result.push_back(path.front());
+    for (auto i = 1u; i + 1 < path.size(); i++)
+    {
+        if (IndexPairToDirection(path[i - 1], path[i], m_width) !=
+            IndexPairToDirection(path[i], path[i + 1], m_width))
+        {
+            m_current_result.push_back(path[i]);
+        }
+    }
+    if (path.size() > 1)
+    {
+        m_current_result.push_back(path.back());
+    }
+}
+
+template <typename NodeStore>
+Router<NodeStore>::Stats
+Router<NodeStore>::GetStats() const
 {
     return m_stats;
 }
 
-template class Router<kTargetCacheSize>;
-template class Router<kUnitTestCacheSize>;
+template class Router<HashNodeStore<kTargetCacheSize>>;
+template class Router<HashNodeStore<kUnitTestCacheSize>>;
+template class Router<DenseNodeStore>;
@@ -0,0 +1,110 @@
+#include "compressed_tile_cache.hh"
+
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+constexpr auto kInvalidOffset = std::numeric_limits<uint32_t>::max();
+
+CompressedTileCache::CompressedTileCache(size_t size, uint32_t tile_count)
+    : m_size(size)
+    , m_data(size ? std::make_unique<uint8_t[]>(size) : nullptr)
+    , m_entries(tile_count)
+    , m_tile_offsets(tile_count, kInvalidOffset)
+{
+}
+
+void
+CompressedTileCache::Read(uint32_t index,
+                          hal::IFlash& flash,
+                          const uint8_t* src,
+                          std::span<uint8_t> dst)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (Lookup(index, dst))
+        {
+            m_stats.hits++;
+            m_stats.saved_flash_bytes += dst.size();
+            return;
+        }
+        m_stats.misses++;
+        m_stats.flash_bytes += dst.size();
+    }
+
+    // Outside the lock, the other decoders can use the cache meanwhile
+    flash.Read(src, dst);
+
+    std::scoped_lock lock(m_mutex);
+    Insert(index, dst);
+}
+
+CompressedTileCache::Stats
+CompressedTileCache::GetStats() const
+{
+    std::scoped_lock lock(m_mutex);
+
+    return m_stats;
+}
+
+bool
+CompressedTileCache::Lookup(uint32_t index, std::span<uint8_t> dst)
+{
+    if (index >= m_tile_offsets.size() || m_tile_offsets[index] == kInvalidOffset)
+    {
+        return false;
+    }
+
+    memcpy(dst.data(), m_data.get() + m_tile_offsets[index], dst.size());
+
+    return true;
+}
+
+void
+CompressedTileCache::Insert(uint32_t index, std::span<const uint8_t> data)
+{
+    if (index >= m_tile_offsets.size() || m_tile_offsets[index] != kInvalidOffset ||
+        data.empty() || data.size() > m_size)
+    {
+        // Already there (decoded twice), or doesn't fit at all
+        return;
+    }
+
+    // The entries ahead of the write offset are the oldest ones, in address order
+    auto is_ahead = [this](const Entry& entry) { return entry.offset >= m_write_offset; };
+
+    if (m_write_offset + data.size() > m_size)
+    {
+        // Wrap around, and drop what's left at the end
+        while (m_entry_count && is_ahead(m_entries[m_first_entry]))
+        {
+            EvictOldest();
+        }
+        m_write_offset = 0;
+    }
+
+    while (m_entry_count && is_ahead(m_entries[m_first_entry]) &&
+           m_entries[m_first_entry].offset < m_write_offset + data.size())
+    {
+        EvictOldest();
+    }
+
+    auto& entry = m_entries[(m_first_entry + m_entry_count) % m_entries.size()];
+    entry = {index, m_write_offset, static_cast<uint32_t>(data.size())};
+    m_entry_count++;
+
+    memcpy(m_data.get() + m_write_offset, data.data(), data.size());
+    m_tile_offsets[index] = m_write_offset;
+    m_write_offset += data.size();
+}
+
+void
+CompressedTileCache::EvictOldest()
+{
+    const auto& entry = m_entries[m_first_entry];
+
+    m_tile_offsets[entry.index] = kInvalidOffset;
+    m_first_entry = (m_first_entry + 1) % m_entries.size();
+    m_entry_count--;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "hal/i_flash.hh"
+
+#include <cstdint>
+#include <etl/mutex.h>
+#include <memory>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Compressed tiles, kept in RAM to avoid re-reading them from flash
+ *
+ * Sized in bytes, and filled as a ring buffer, so the oldest tiles are dropped first. Safe to
+ * use from several decoder threads.
+ */
+class CompressedTileCache
+{
+public:
+    struct Stats
+    {
+        // Tiles found in the cache
+        unsigned hits {0};
+        // Tiles read from flash
+        unsigned misses {0};
+        // Bytes read from flash, and bytes which didn't have to be
+        uint64_t flash_bytes {0};
+        uint64_t saved_flash_bytes {0};
+    };
+
+    /**
+     * @brief Create the cache
+     *
+     * @param size the size in bytes, or zero to always read from flash
+     * @param tile_count the number of tiles in the map
+     */
+    CompressedTileCache(size_t size, uint32_t tile_count);
+
+    /**
+     * @brief Read a tile, from the cache or from flash
+     *
+     * @param index the tile index
+     * @param flash the flash to read from on a miss
+     * @param src the tile in flash
+     * @param dst the destination, the size of the tile
+     */
+    void Read(uint32_t index, hal::IFlash& flash, const uint8_t* src, std::span<uint8_t> dst);
+
+    Stats GetStats() const;
+
+private:
+    struct Entry
+    {
+        uint32_t index;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Called with m_mutex held
+    bool Lookup(uint32_t index, std::span<uint8_t> dst);
+    void Insert(uint32_t index, std::span<const uint8_t> data);
+    void EvictOldest();
+
+    const size_t m_size;
+    std::unique_ptr<uint8_t[]> m_data;
+
+    // Oldest first, in ring buffer order
+    std::vector<Entry> m_entries;
+    uint32_t m_first_entry {0};
+    uint32_t m_entry_count {0};
+    uint32_t m_write_offset {0};
+
+    // Tile index -> the offset in m_data
+    std::vector<uint32_t> m_tile_offsets;
+
+    Stats m_stats;
+
+    mutable etl::mutex m_mutex;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "tile.hh"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+// How the tile palette is remapped when drawn, for the color modes
+struct TileStyle
+{
+    // Grayscale, with the land hatched in hatch_color
+    bool grayscale {false};
+    uint16_t hatch_color {0};
+};
+
+// A tile palette remapped for a TileStyle, to expand rows of palette indices to RGB565
+class StyledPalette
+{
+public:
+    // The palette is referenced, not copied, unless remapped
+    StyledPalette(std::span<const uint16_t, 256> palette, const TileStyle& style);
+
+    /**
+     * @brief Expand a row of palette indices, nearest neighbor
+     *
+     * @param src the first palette index, then every factor:th is used
+     * @param phase x + y of the first pixel, in full size tile pixels, for the hatch pattern
+     * @param dst the destination, filled completely
+     * @param factor the downscale factor
+     */
+    void ExpandRow(const uint8_t* src,
+                   unsigned phase,
+                   std::span<uint16_t> dst,
+                   unsigned factor) const;
+
+private:
+    const uint16_t* m_colors;
+    bool m_hatched;
+
+    // For the grayscale style
+    std::array<uint16_t, 256> m_grayscale;
+    std::array<uint16_t, 256> m_hatched_colors;
+};
+
+// A decoded tile, as 8-bit palette indices. The colors are expanded when drawn
+class IndexedTile
+{
+public:
+    // The index of an unused tile
+    static constexpr auto kNoTile = std::numeric_limits<unsigned>::max();
+
+    void Blit(uint16_t* frame_buffer, const Point& at, const TileStyle& style = {}) const;
+
+    void ZoomedBlit(uint16_t* frame_buffer,
+                    unsigned width,
+                    unsigned factor,
+                    const Point& at,
+                    const TileStyle& style = {}) const;
+
+    unsigned int index {kNoTile};
+    bool prefetched {false};
+    std::array<uint16_t, 256> palette {};
+    std::array<uint8_t, kTileSize * kTileSize> pixels;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief The recency order of the entries 0..size-1, least recently used first
+ *
+ * The entries are linked through index arrays, so everything but the iteration is O(1).
+ * Entries can be unlinked while in use, and are then skipped by the iteration.
+ */
+class LruList
+{
+public:
+    explicit LruList(uint16_t size)
+        : m_next(size + 1)
+        , m_prev(size + 1)
+        , m_head(size)
+    {
+        // Unlinked entries point to themselves
+        for (auto i = 0u; i <= size; i++)
+        {
+            m_next[i] = i;
+            m_prev[i] = i;
+        }
+    }
+
+    void PushMostRecent(uint16_t index)
+    {
+        Unlink(index);
+        Link(index, m_prev[m_head], m_head);
+    }
+
+    void PushLeastRecent(uint16_t index)
+    {
+        Unlink(index);
+        Link(index, m_head, m_next[m_head]);
+    }
+
+    void Unlink(uint16_t index)
+    {
+        assert(index < m_head);
+
+        m_next[m_prev[index]] = m_next[index];
+        m_prev[m_next[index]] = m_prev[index];
+        m_next[index] = index;
+        m_prev[index] = index;
+    }
+
+    bool IsLinked(uint16_t index) const
+    {
+        return m_next[index] != index;
+    }
+
+    std::optional<uint16_t> LeastRecent() const
+    {
+        return Valid(m_next[m_head]);
+    }
+
+    std::optional<uint16_t> MoreRecent(uint16_t index) const
+    {
+        return Valid(m_next[index]);
+    }
+
+private:
+    void Link(uint16_t index, uint16_t prev, uint16_t next)
+    {
+        m_prev[index] = prev;
+        m_next[index] = next;
+        m_next[prev] = index;
+        m_prev[next] = index;
+    }
+
+    std::optional<uint16_t> Valid(uint16_t index) const
+    {
+        if (index == m_head)
+        {
+            return std::nullopt;
+        }
+
+        return index;
+    }
+
+    // The last entry is the list head
+    std::vector<uint16_t> m_next;
+    std::vector<uint16_t> m_prev;
+    const uint16_t m_head;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "hal/i_flash.hh"
+#include "tile.hh"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+/**
+ * @brief A PNG decoder for the tiles written by tools/tiler.py
+ *
+ * Only handles kTileSize x kTileSize, 8-bit palette, non-interlaced PNGs, which is what all the
+ * map tiles are. Everything else is left to PNGdec. The zlib stream is inflated into a fixed
+ * 32 KiB window, and the rows are unfiltered as they come out of it, so the compressed tile is
+ * read once, front to back. The CRCs and the Adler-32 checksum are not verified (same as
+ * PNGdec).
+ */
+class PalettePngDecoder
+{
+public:
+    enum class Result
+    {
+        kDecoded,
+        // Another kind of PNG, decode it with PNGdec
+        kUnsupported,
+        kCorrupt,
+    };
+
+    // Called for each row, top to bottom, with kTileSize palette indices
+    using OnRow = void (*)(void* user, unsigned y, const uint8_t* indices);
+
+    // Allocates the window and the Huffman tables up front
+    PalettePngDecoder();
+
+    ~PalettePngDecoder();
+
+    /**
+     * @brief Decode a tile in memory
+     *
+     * @param data the PNG
+     * @param palette the RGB565 palette, filled before the first row. Unused entries are black
+     * @param on_row called for each row
+     * @param user passed to @a on_row
+     *
+     * @return the result
+     */
+    Result Decode(std::span<const uint8_t> data,
+                  std::span<uint16_t, 256> palette,
+                  OnRow on_row,
+                  void* user);
+
+    /**
+     * @brief Decode a tile in flash, read in small chunks
+     *
+     * @param flash the flash to read from
+     * @param src the PNG in flash
+     * @param size the size of the PNG
+     *
+     * See the other overload for the rest.
+     */
+    Result Decode(hal::IFlash& flash,
+                  const uint8_t* src,
+                  size_t size,
+                  std::span<uint16_t, 256> palette,
+                  OnRow on_row,
+                  void* user);
+
+private:
+    struct State;
+
+    Result DecodeRows(std::span<uint16_t, 256> palette, OnRow on_row, void* user);
+
+    std::unique_ptr<State> m_state;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/*
+ * Row conversion kernels for the tile and icon drawing. The *Reference versions are the
+ * straightforward per-pixel implementations, which the optimized ones should match exactly.
+ */
+
+/**
+ * @brief Expand palette indices to RGB565
+ *
+ * @param src the palette indices, every step:th is used
+ * @param palette the RGB565 palette
+ * @param dst the output row, all of it is written
+ * @param step the distance between the used indices, e.g., the zoom factor
+ */
+void IndexedToRgb565Row(const uint8_t* src,
+                        const uint16_t* palette,
+                        std::span<uint16_t> dst,
+                        unsigned step = 1);
+
+void IndexedToRgb565RowReference(const uint8_t* src,
+                                 const uint16_t* palette,
+                                 std::span<uint16_t> dst,
+                                 unsigned step = 1);
+
+/**
+ * @brief Expand palette indices to RGB565, with a hatch pattern
+ *
+ * The pixels where (x + y) % 6 < 2, in source pixels, use @a hatched_palette. To hatch the
+ * land, it's the palette with the land entries replaced by the hatch color.
+ *
+ * @param src the palette indices, every step:th is used
+ * @param palette the RGB565 palette
+ * @param hatched_palette the RGB565 palette for the hatch lines
+ * @param phase (x + y) of the first pixel
+ * @param dst the output row, all of it is written
+ * @param step the distance between the used indices, e.g., the zoom factor
+ */
+void HatchedIndexedToRgb565Row(const uint8_t* src,
+                               const uint16_t* palette,
+                               const uint16_t* hatched_palette,
+                               unsigned phase,
+                               std::span<uint16_t> dst,
+                               unsigned step = 1);
+
+void HatchedIndexedToRgb565RowReference(const uint8_t* src,
+                                        const uint16_t* palette,
+                                        const uint16_t* hatched_palette,
+                                        unsigned phase,
+                                        std::span<uint16_t> dst,
+                                        unsigned step = 1);
+
+/**
+ * @brief Expand RGB565 pixels to 4 bytes per pixel, as lvgl expects
+ *
+ * @param src the RGB565 pixels
+ * @param dst the output, 4 bytes per source pixel
+ * @param transparent_color pixels of this color get alpha 0, the rest 255
+ */
+void Rgb565ToArgb8888Row(std::span<const uint16_t> src,
+                         uint8_t* dst,
+                         std::optional<uint16_t> transparent_color);
+
+void Rgb565ToArgb8888RowReference(std::span<const uint16_t> src,
+                                  uint8_t* dst,
+                                  std::optional<uint16_t> transparent_color);
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/*
+ * The palette + run-length tile codec (TileCodec::kPaletteRle), emitted by tools/tiler.py:
+ *
+ *   uint8_t palette_size (1..64)
+ *   uint16_t palette[palette_size] (RGB565, little endian)
+ *   runs, until the tile is filled:
+ *     uint8_t (n << 6) | palette_index
+ *       n < 3: a run of n + 1 pixels
+ *       n == 3: followed by uint8_t length, a run of length + 4 pixels
+ *
+ * The runs continue over the row ends.
+ */
+constexpr auto kPaletteRleMaxColors = 64;
+constexpr auto kPaletteRleShortRuns = 3;
+constexpr auto kPaletteRleLongRunBase = 4;
+
+/**
+ * @brief Decode a palette + run-length tile to palette indices
+ *
+ * @param data the encoded tile
+ * @param dst the palette indices, which should be filled exactly
+ * @param palette the RGB565 palette, at least kPaletteRleMaxColors entries
+ *
+ * @return true if the tile was decoded, false if it's corrupt
+ */
+bool DecodePaletteRleTile(std::span<const uint8_t> data,
+                          std::span<uint8_t> dst,
+                          std::span<uint16_t> palette);
+
+/**
+ * @brief Parse a palette + run-length tile, run by run
+ *
+ * @param data the encoded tile
+ * @param pixels the number of pixels in the tile, which should be filled exactly
+ * @param palette the RGB565 palette, at least kPaletteRleMaxColors entries
+ * @param on_run called as on_run(offset, length, palette_index) for each run
+ *
+ * @return true if the tile was parsed, false if it's corrupt
+ */
+template <typename OnRun>
+bool
+ForEachPaletteRleRun(std::span<const uint8_t> data,
+                     size_t pixels,
+                     std::span<uint16_t> palette,
+                     OnRun&& on_run)
+{
+    if (data.empty() || palette.size() < kPaletteRleMaxColors)
+    {
+        return false;
+    }
+
+    const auto palette_size = data[0];
+    if (palette_size == 0 || palette_size > kPaletteRleMaxColors ||
+        data.size() < 1 + palette_size * sizeof(uint16_t))
+    {
+        return false;
+    }
+
+    for (auto i = 0u; i < palette_size; i++)
+    {
+        palette[i] = data[1 + i * 2] | (data[2 + i * 2] << 8);
+    }
+
+    auto src = data.begin() + 1 + palette_size * sizeof(uint16_t);
+    size_t offset = 0;
+
+    while (offset != pixels)
+    {
+        if (src == data.end())
+        {
+            return false;
+        }
+
+        const auto value = *src++;
+        const auto index = static_cast<uint8_t>(value % kPaletteRleMaxColors);
+        auto length = static_cast<unsigned>(value / kPaletteRleMaxColors) + 1;
+
+        if (length > kPaletteRleShortRuns)
+        {
+            if (src == data.end())
+            {
+                return false;
+            }
+            length = *src++ + kPaletteRleLongRunBase;
+        }
+
+        if (index >= palette_size || length > pixels - offset)
+        {
+            return false;
+        }
+
+        on_run(offset, length, index);
+        offset += length;
+    }
+
+    // Trailing data means a mismatching tile size
+    return src == data.end();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "hal/i_flash.hh"
+#include "indexed_tile.hh"
+#include "palette_png_decoder.hh"
+#include "tile.hh"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+
+class PNG;
+
+/**
+ * @brief Decodes tiles to palette indices, with everything allocated up front
+ *
+ * One per decoder thread, since the PNG decoders keep state. The map tile PNGs are decoded by
+ * PalettePngDecoder, other PNGs by PNGdec.
+ */
+class TileDecoder
+{
+public:
+    /**
+     * @brief Create the decoder
+     *
+     * @param max_tile_size the size of the largest compressed tile, for the staging buffer.
+     * Only the tiles which are not decoded by DecodeFromFlash() need to fit
+     * @param palette_png_decoder decode the map tile PNGs with PalettePngDecoder, false to always
+     * use PNGdec (e.g., to compare them)
+     */
+    explicit TileDecoder(size_t max_tile_size, bool palette_png_decoder = true);
+
+    ~TileDecoder();
+
+    /**
+     * @brief Return the staging buffer, to read the compressed tile into
+     *
+     * @param size the size of the compressed tile, at most max_tile_size
+     *
+     * @return the first @a size bytes of the staging buffer
+     */
+    std::span<uint8_t> GetStagingBuffer(size_t size);
+
+    /**
+     * @brief Decode a tile
+     *
+     * @param codec the tile codec
+     * @param data the compressed tile, e.g., in the staging buffer
+     * @param tile the destination, the index is left untouched
+     *
+     * @return true if the tile was decoded
+     */
+    bool Decode(TileCodec codec, std::span<const uint8_t> data, IndexedTile& tile);
+
+    /**
+     * @brief Decode a tile straight from flash, without copying it to the staging buffer
+     *
+     * PNG tiles are streamed, i.e., read from @a flash in small chunks (or through PNGdec's
+     * file callbacks, for other PNGs). Other codecs are copied to the staging buffer.
+     *
+     * @param codec the tile codec
+     * @param flash the flash to read from
+     * @param src the compressed tile in flash
+     * @param size the size of the compressed tile
+     * @param tile the destination, the index is left untouched
+     *
+     * @return true if the tile was decoded
+     */
+    bool DecodeFromFlash(TileCodec codec,
+                         hal::IFlash& flash,
+                         const uint8_t* src,
+                         size_t size,
+                         IndexedTile& tile);
+
+    /**
+     * @brief Decode a tile straight from flash to RGB565, downscaled
+     *
+     * For one-off users like the menu thumbnails. The rows are downscaled and expanded while
+     * decoding, so no IndexedTile is needed. PNG tiles are always streamed from @a flash, other
+     * codecs are copied to the staging buffer.
+     *
+     * @param codec the tile codec
+     * @param flash the flash to read from
+     * @param src the compressed tile in flash
+     * @param size the size of the compressed tile
+     * @param factor the downscale factor, nearest neighbor. kTileSize must be divisible by it
+     * @param dst the destination, (kTileSize / factor)^2 RGB565 pixels
+     * @param style the color mode style
+     *
+     * @return true if the tile was decoded
+     */
+    bool DecodeScaledFromFlash(TileCodec codec,
+                               hal::IFlash& flash,
+                               const uint8_t* src,
+                               size_t size,
+                               unsigned factor,
+                               std::span<uint16_t> dst,
+                               const TileStyle& style = {});
+
+private:
+    // Called when the PNG has been opened
+    bool DecodePng(IndexedTile& tile);
+
+    std::unique_ptr<PNG> m_png;
+    std::unique_ptr<PalettePngDecoder> m_palette_png;
+    std::unique_ptr<uint8_t[]> m_staging;
+    const size_t m_staging_size;
+
+    // For non-palette PNGs
+    std::array<uint16_t, kTileSize> m_line_buffer;
+
+    // For DecodeScaledFromFlash
+    std::array<uint8_t, kTileSize> m_index_row;
+    std::array<uint16_t, 256> m_scaled_palette;
+    std::optional<StyledPalette> m_styled_palette;
+};
@@ -2,89 +2,358 @@
 
 #include "application_state.hh"
 #include "base_thread.hh"
+#include "compressed_tile_cache.hh"
 #include "hal/i_display.hh"
+#include "hal/i_flash.hh"
 #include "image.hh"
+#include "indexed_tile.hh"
+#include "lru_list.hh"
 #include "tile.hh"
+#include "tile_decoder.hh"
+#include "tile_request_queue.hh"
+#include "time_histogram.hh"
 
-#include <atomic>
-#include <etl/list.h>
+#include <array>
 #include <etl/mutex.h>
-#include <etl/queue_spsc_atomic.h>
 #include <etl/vector.h>
 #include <memory>
 #include <vector>
 
-// Cache all visible tiles, plus a few for good measure
-constexpr auto kTileCacheSize =
-    2 + ((hal::kDisplayWidth / kTileSize) + 1) * ((hal::kDisplayHeight / kTileSize) + 1);
-static_assert(kTileCacheSize <= 32); // For the uint32_t atomic
+constexpr auto kVisibleTileCount =
+    ((hal::kDisplayWidth / kTileSize) + 1) * ((hal::kDisplayHeight / kTileSize) + 1);
+
+// Tiles decoded ahead of the boat
+constexpr auto kTilePrefetchCount = 4;
+
+// Cache at least all visible tiles, the prefetched ones, plus a few for good measure
+constexpr auto kMinTileCacheSize = 2 + kVisibleTileCount + kTilePrefetchCount;
+
+// The tiles are palette indexed, i.e., half the size of RGB565 ones, so twice as many fit in
+// the same memory. Targets with more memory can choose a larger cache
+constexpr auto kDefaultTileCacheSize = 2 * kMinTileCacheSize;
+
+// The compressed tiles kept in RAM below the decoded ones, in bytes. Around 100 PNG tiles
+constexpr auto kDefaultCompressedTileCacheSize = 512 * 1024;
+
+// Outstanding LockTile/TryLockTile requests, per priority class
+constexpr auto kMaxTileRequests = kMinTileCacheSize;
+
+// Enough for the zoomed out (4x) overview map
+constexpr auto kMaxRequestedTiles =
+    (hal::kDisplayWidth / kTileSize) * 4 * (hal::kDisplayHeight / kTileSize) * 4;
 
 class ITileHandle
 {
 public:
     virtual ~ITileHandle() = default;
 
-    virtual const Image& GetImage() const = 0;
+    /**
+     * @brief Draw the tile, clipped to the display
+     *
+     * @param frame_buffer the RGB565 display frame buffer
+     * @param at the position of the upper left corner of the tile
+     */
+    virtual void Blit(uint16_t* frame_buffer, const Point& at) const = 0;
+
+    /**
+     * @brief Draw the tile scaled down by @a factor
+     *
+     * @param frame_buffer the RGB565 frame buffer, at most the display height
+     * @param width the width of the frame buffer
+     * @param factor the zoom factor
+     * @param at the position of the upper left corner of the scaled tile
+     */
+    virtual void
+    ZoomedBlit(uint16_t* frame_buffer, unsigned width, unsigned factor, const Point& at) const = 0;
 };
 
-class ImageImpl : public Image
+struct TileProducerConfig
 {
-public:
-    ImageImpl(unsigned index)
-        : Image(std::span<const uint8_t>(rgb565_data), kTileSize, kTileSize, false)
-        , index(index)
-    {
-    }
-
-    ~ImageImpl()
-    {
-    }
-
-    unsigned int index;
-    std::array<uint8_t, kTileSize * kTileSize * sizeof(uint16_t)> rgb565_data;
+    // The number of decoded tiles to cache, at least kMinTileCacheSize
+    unsigned cache_size {kDefaultTileCacheSize};
+    // The size of the compressed tile cache in bytes, zero to always read from flash
+    size_t compressed_cache_size {kDefaultCompressedTileCacheSize};
+    // The number of threads decoding tiles, including the producer. The extra decoders run
+    // on the second core
+    unsigned decoder_threads {1};
+    // Decode the PNG tiles straight from flash, instead of copying them to RAM first. Saves
+    // the copy, but bypasses the compressed tile cache (which is then not allocated)
+    bool direct_flash_decode {false};
+    // The flash to read tiles from, memory mapped if nullptr
+    hal::IFlash* flash {nullptr};
 };
 
 class TileProducer : public os::BaseThread
 {
 public:
-    TileProducer(ApplicationState& application_state, const MapMetadata& flash_tile_data);
+    struct Stats
+    {
+        // Tiles decoded ahead of the boat
+        unsigned prefetched {0};
+        // Tiles found in the cache thanks to the prefetcher
+        unsigned prefetch_hits {0};
+        // Tiles ahead of the boat which were not decoded when needed
+        unsigned prefetch_misses {0};
+        // Prefetched tiles evicted before being used
+        unsigned prefetch_unused {0};
+        // Tiles evicted to make room for new ones
+        unsigned evictions {0};
+
+        // Decoded tiles found in the cache, and tiles which had to be decoded
+        unsigned cache_hits {0};
+        unsigned cache_misses {0};
+        // The compressed tier, i.e., tiles decoded without reading flash. Only the flash reads
+        // with direct_flash_decode
+        CompressedTileCache::Stats compressed;
+
+        // The time to decode a tile, and the time from requesting a missing tile until it's cached
+        TimeHistogram decode_time;
+        TimeHistogram lock_wait_time;
+
+        // Outstanding LockTile/TryLockTile/prefetch requests, now and at most
+        unsigned queue_depth {0};
+        unsigned max_queue_depth {0};
+    };
+
+    /**
+     * @brief Create the tile producer
+     *
+     * @param application_state the application state
+     * @param flash_tile_data the map metadata, followed by the tiles
+     * @param config the cache sizes and decoders
+     */
+    TileProducer(ApplicationState& application_state,
+                 const MapMetadata& flash_tile_data,
+                 const TileProducerConfig& config = {});
+
+    ~TileProducer();
+
+    /**
+     * @brief Return if the map has zoomed out tiles for a zoom level
+     *
+     * The zoomed out tiles are kTileSize pixels as well, but cover @a zoom x @a zoom tiles.
+     * They are addressed by the global pixel position, like the full size tiles.
+     *
+     * @param zoom the zoom level, 2 or 4
+     */
+    bool HasZoomedTiles(unsigned zoom) const;
+
+    /**
+     * @brief Lock a tile, and wait for it to be decoded if needed
+     *
+     * @param point the global pixel position of the tile
+     * @param zoom the zoom level, see HasZoomedTiles()
+     * @param priority the priority of the request
+     *
+     * @return the tile, or nullptr if outside the map, the request was cancelled, or the
+     * requests with @a priority are full
+     */
+    // Context: Another thread
+    std::unique_ptr<ITileHandle> LockTile(const Point& point,
+                                          unsigned zoom = 1,
+                                          TilePriority priority = TilePriority::kVisible);
+
+    /**
+     * @brief Lock a tile if it's cached, otherwise request it without waiting
+     *
+     * @param point the global pixel position of the tile
+     * @param ready released when the requested tile has been decoded, or the request cancelled
+     * @param zoom the zoom level, see HasZoomedTiles()
+     * @param priority the priority of the request
+     *
+     * @return the tile, or nullptr if it's pending
+     */
+    std::unique_ptr<ITileHandle> TryLockTile(const Point& point,
+                                             os::binary_semaphore& ready,
+                                             unsigned zoom = 1,
+                                             TilePriority priority = TilePriority::kVisible);
+
+    /**
+     * @brief Request a set of tiles, replacing the previously requested set
+     *
+     * Missing tiles are decoded closest to @a center first. At most a cache-full is decoded
+     * per call, so the caller should draw what's ready and then request the rest. The set
+     * supersedes the queued TryLockTile/LockTile requests with the same priority, which are
+     * cancelled.
+     *
+     * @param points the global pixel positions of the tiles
+     * @param center the position to order by, e.g., the boat or the crosshair
+     * @param ready released when the set (or a cache-full of it) has been decoded
+     * @param zoom the zoom level, see HasZoomedTiles()
+     * @param priority the priority of the single tile requests to cancel
+     *
+     * @return the number of tiles which are still pending
+     */
+    unsigned RequestTiles(std::span<const Point> points,
+                          const Point& center,
+                          os::binary_semaphore& ready,
+                          unsigned zoom = 1,
+                          TilePriority priority = TilePriority::kVisible);
 
+    /**
+     * @brief Decode a tile straight into a buffer, downscaled, bypassing the cache
+     *
+     * For one-off users like the menu thumbnails, which would otherwise evict the tiles the
+     * map screen needs. Queued with the thumbnail priority, and decoded by the decoder threads
+     * while the caller waits.
+     *
+     * @param point the global pixel position of the tile
+     * @param factor the downscale factor, kTileSize must be divisible by it
+     * @param dst the destination, (kTileSize / factor)^2 RGB565 pixels
+     *
+     * @return true if the tile was decoded
+     */
     // Context: Another thread
-    std::unique_ptr<ITileHandle> LockTile(const Point& point);
+    bool DecodeTileTo(const Point& point, unsigned factor, std::span<uint16_t> dst);
 
-    bool IsCached(const Point& point) const;
+    bool IsCached(const Point& point, unsigned zoom = 1) const;
+
+    // Context: Another thread
+    Stats GetStats() const;
 
 private:
+    class DecodeWorker;
+    class TileHandle;
+
+    // A DecodeTileTo request, filled in by the decoder
+    struct ScaledTileRequest
+    {
+        unsigned factor;
+        std::span<uint16_t> dst;
+        TileStyle style;
+        bool decoded;
+    };
+
+    struct TileRequest
+    {
+        uint32_t index;
+        os::binary_semaphore* ready;
+        bool prefetch;
+        // Decoded to the caller's buffer instead of the cache
+        ScaledTileRequest* scaled {nullptr};
+        // When a requester started waiting for the tile, unset for prefetches
+        std::chrono::steady_clock::time_point requested {};
+    };
+
+    struct RequestedTile
+    {
+        uint32_t index;
+        uint32_t distance;
+    };
+
+    // The full size tiles, and the zoomed out levels after them in the same index space
+    struct ZoomLevel
+    {
+        unsigned zoom;
+        const FlashTile* tiles;
+        uint32_t first_index;
+        uint32_t count;
+        uint32_t row_size;
+    };
+    using ZoomLevels = std::array<ZoomLevel, 1 + kZoomedTileLevels>;
+
+    static ZoomLevels GetZoomLevels(const MapMetadata& metadata);
+
     void OnStartup() final;
     std::optional<milliseconds> OnActivation() final;
 
-    std::unique_ptr<ImageImpl> DecodeTile(unsigned index);
+    bool DecodeTile(TileDecoder& decoder, unsigned index, IndexedTile& tile);
+    bool DecodeScaledTile(TileDecoder& decoder, unsigned index, const ScaledTileRequest& request);
 
-    bool CacheTile(unsigned index);
+    bool CacheTile(TileDecoder& decoder, const TileRequest& request);
 
-    uint8_t EvictTile();
-    std::optional<unsigned> PointToTileIndex(const Point& point) const;
+    // Context: Any decoder thread
+    void DecodeRequestedTiles(TileDecoder& decoder);
+
+    // Called with m_mutex held
+    std::optional<uint32_t> PopRequestedTile();
+    void CompleteRequestedTiles();
+
+    void WakeDecoders();
+
+    // Called with m_mutex held
+    bool PushTileRequest(TilePriority priority, const TileRequest& request);
+    std::optional<TileRequest> PopTileRequest(TilePriority lowest);
+
+    // Called with m_mutex held
+    std::unique_ptr<ITileHandle> LockCacheEntry(uint16_t cache_index);
+    void UnlockCacheEntry(uint16_t cache_index);
+    void CountCacheMiss(uint32_t index);
+    void RecordLockWait(const TileRequest& request);
+
+    void PrefetchTiles();
+    etl::vector<uint32_t, kVisibleTileCount> VisibleTiles(const Point& position) const;
+
+    std::optional<uint16_t> EvictTile(bool keep_visible);
+    void IndexSharedPayloads();
+    std::optional<unsigned> PointToTileIndex(const Point& point, unsigned zoom = 1) const;
+    const ZoomLevel* GetZoomLevel(unsigned zoom) const;
+    const FlashTile& GetFlashTile(unsigned index) const;
 
     const uint8_t* m_flash_start;
-    const FlashTile* m_flash_tile_data;
     const uint32_t m_tile_count;
     const uint32_t m_tile_row_size;
     const uint32_t m_tile_rows;
+    const ZoomLevels m_zoom_levels;
+    // Including the zoomed out ones
+    const uint32_t m_all_tile_count;
+    const uint16_t m_cache_size;
+
+    std::unique_ptr<hal::IFlash> m_mapped_flash;
+    hal::IFlash& m_flash;
+    CompressedTileCache m_compressed_tiles;
 
     ApplicationState &m_application_state;
     std::unique_ptr<ListenerCookie> m_state_listener;
 
-    etl::vector<std::unique_ptr<ImageImpl>, kTileCacheSize> m_tiles;
-    etl::list<uint32_t, kTileCacheSize> m_tile_request_order;
-    std::atomic<uint32_t> m_locked_cache_entries {0};
-    std::vector<uint8_t> m_tile_index_to_cache;
+    // The producer thread decodes too, the workers help out
+    const bool m_direct_flash_decode;
+    // The staging buffer size of the decoders
+    const size_t m_max_tile_size;
+    TileDecoder m_decoder;
+    std::vector<std::unique_ptr<DecodeWorker>> m_workers;
+
+    // Allocated up front, so decoding tiles doesn't fragment the heap
+    std::vector<IndexedTile> m_tiles;
+    // The unlocked cache entries, empty ones first. Locked entries, and entries being decoded
+    // into, are unlinked
+    LruList m_lru;
+    std::vector<uint8_t> m_lock_count;
+    std::vector<uint16_t> m_tile_index_to_cache;
+    // Tiles with the same payload in flash (open water, inland) are decoded once, and cached
+    // as the first tile index with that payload
+    std::vector<uint32_t> m_payload_tile_index;
+    std::vector<bool> m_pending_tiles;
 
-    etl::queue_spsc_atomic<uint32_t, kTileCacheSize> m_tile_requests;
+    // The single tile requests. Pushed and popped with m_mutex held, to keep m_pending_tiles
+    // in sync
+    TileRequestQueue<TileRequest, kMaxTileRequests> m_tile_requests;
     os::binary_semaphore m_tile_request_semaphore {0};
 
-    ApplicationState::PartialReadOnlyCache<AS::configuration> m_state_cache;
+    // The last requested set, sorted with the farthest tile first
+    etl::vector<RequestedTile, kMaxRequestedTiles> m_requested_tiles;
+    unsigned m_requested_tiles_budget {0};
+    unsigned m_requested_tiles_in_flight {0};
+    os::binary_semaphore* m_requested_tiles_ready {nullptr};
+    std::chrono::steady_clock::time_point m_requested_tiles_time;
+
+    ApplicationState::PartialReadOnlyCache<AS::configuration, AS::pixel_position, AS::position>
+        m_state_cache;
     ColorMode m_color_mode {ColorMode::kColor};
 
+    // The boat position and track, for the prefetcher. Written by the producer thread with
+    // m_mutex held, which EvictTile() holds when reading them
+    Point m_position {0, 0};
+    float m_heading {0};
+    float m_speed {0};
+    // The tiles ahead of the boat from the last PrefetchTiles(), for the prefetch statistics
+    etl::vector<uint32_t, kTilePrefetchCount> m_prefetch_tiles;
+    // The boat tile and heading the prefetch was made from, only used by the producer thread
+    std::optional<unsigned> m_prefetch_origin;
+    float m_prefetch_heading {0};
+
+    Stats m_stats;
+
     mutable etl::mutex m_mutex;
 };
 
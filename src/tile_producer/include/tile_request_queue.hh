@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <etl/mutex.h>
+#include <etl/queue.h>
+#include <mutex>
+#include <optional>
+
+enum class TilePriority : uint8_t
+{
+    // The tiles on the map screen
+    kVisible = 0,
+    // The zoomed out overview map
+    kOverview,
+    // The menu thumbnails
+    kThumbnail,
+    // The tiles ahead of the boat
+    kPrefetch,
+
+    kValueCount,
+};
+
+/**
+ * @brief Tile requests from several threads, popped highest priority first
+ *
+ * Each priority class has a generation, and Cancel() moves on to the next one. The requests
+ * from older generations are not removed right away, but handed to the consumer as cancelled
+ * when popped, so that the requester can be notified. Safe to use from several producer and
+ * consumer threads.
+ */
+template <typename T, size_t SIZE>
+class TileRequestQueue
+{
+public:
+    /**
+     * @brief Queue a request
+     *
+     * @param priority the priority class
+     * @param request the request
+     *
+     * @return false if the class is full. Cancelled requests take space until popped
+     */
+    bool Push(TilePriority priority, const T& request)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        auto& queue = m_queues[Index(priority)];
+        if (queue.full())
+        {
+            return false;
+        }
+        queue.push({request, m_generations[Index(priority)]});
+
+        return true;
+    }
+
+    // Cancel the requests queued so far in a priority class, e.g., when superseded
+    void Cancel(TilePriority priority)
+    {
+        Cancel(priority, [](const T&) {});
+    }
+
+    /**
+     * @brief Cancel the requests queued so far in a priority class
+     *
+     * @param priority the priority class
+     * @param on_cancel called right away with each request cancelled now. They are still handed
+     * to Pop() as cancelled later
+     */
+    template <typename OnCancel>
+    void Cancel(TilePriority priority, OnCancel on_cancel)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        auto& queue = m_queues[Index(priority)];
+        auto& generation = m_generations[Index(priority)];
+
+        // Once around the queue, which keeps the order
+        for (auto i = queue.size(); i > 0; i--)
+        {
+            auto entry = queue.front();
+            queue.pop();
+
+            if (entry.generation == generation)
+            {
+                on_cancel(entry.request);
+            }
+            queue.push(entry);
+        }
+        generation++;
+    }
+
+    /**
+     * @brief Pop the highest priority request
+     *
+     * @param lowest the lowest priority class to pop from
+     * @param on_cancelled called with the cancelled requests skipped on the way
+     *
+     * @return the request, or std::nullopt if there are none down to @a lowest
+     */
+    template <typename OnCancelled>
+    std::optional<T> Pop(TilePriority lowest, OnCancelled on_cancelled)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        for (auto i = 0u; i <= Index(lowest); i++)
+        {
+            auto& queue = m_queues[i];
+
+            while (!queue.empty())
+            {
+                auto entry = queue.front();
+                queue.pop();
+
+                if (entry.generation == m_generations[i])
+                {
+                    return entry.request;
+                }
+                on_cancelled(entry.request);
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // The number of queued requests, including cancelled ones not yet popped
+    size_t Size() const
+    {
+        std::scoped_lock lock(m_mutex);
+
+        size_t out = 0;
+        for (const auto& queue : m_queues)
+        {
+            out += queue.size();
+        }
+
+        return out;
+    }
+
+private:
+    struct Entry
+    {
+        T request;
+        uint32_t generation;
+    };
+
+    static constexpr unsigned Index(TilePriority priority)
+    {
+        return static_cast<unsigned>(priority);
+    }
+
+    static constexpr auto kPriorities = Index(TilePriority::kValueCount);
+
+    std::array<etl::queue<Entry, SIZE>, kPriorities> m_queues;
+    std::array<uint32_t, kPriorities> m_generations {};
+    mutable etl::mutex m_mutex;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief A histogram of durations, in power of two microsecond buckets
+ *
+ * Bucket 0 holds durations below 1us, bucket n durations in [2^(n-1), 2^n) us, and the last
+ * bucket everything longer. Recording is a few instructions, so it's always enabled.
+ */
+class TimeHistogram
+{
+public:
+    using microseconds = std::chrono::duration<uint32_t, std::micro>;
+
+    // The last bucket starts at ~0.5s
+    static constexpr auto kBuckets = 21;
+
+    void Record(std::chrono::steady_clock::duration duration)
+    {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        auto value = static_cast<uint32_t>(std::max<decltype(us)>(us, 0));
+
+        buckets[std::min<unsigned>(std::bit_width(value), kBuckets - 1)]++;
+        count++;
+        total_us += value;
+        max_us = std::max(max_us, value);
+    }
+
+    microseconds Average() const
+    {
+        return microseconds(count == 0 ? 0 : static_cast<uint32_t>(total_us / count));
+    }
+
+    microseconds Max() const
+    {
+        return microseconds(max_us);
+    }
+
+    /**
+     * @brief Return the upper bound of the bucket holding a percentile
+     *
+     * @param percent the percentile, e.g., 50 for the median
+     *
+     * @return the upper bound, i.e., at most twice the actual value. Max() for the last bucket
+     */
+    microseconds Percentile(unsigned percent) const
+    {
+        // The rank of the sample, rounded up
+        auto rank = (static_cast<uint64_t>(count) * percent + 99) / 100;
+        uint64_t seen = 0;
+
+        for (auto i = 0u; i < kBuckets - 1; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank && seen > 0)
+            {
+                return microseconds(std::min(max_us, (1u << i) - 1));
+            }
+        }
+
+        return Max();
+    }
+
+    std::array<uint32_t, kBuckets> buckets {};
+    uint32_t count {0};
+    uint64_t total_us {0};
+    uint32_t max_us {0};
+};
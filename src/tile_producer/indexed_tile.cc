@@ -0,0 +1,111 @@
+#include "indexed_tile.hh"
+
+#include "hal/i_display.hh"
+#include "pixel_kernels.hh"
+
+#include <algorithm>
+
+namespace
+{
+
+// r: 254, g: 242, b: 203 in rgb565 (after pillow + png conversion). TODO: Don't hardcode
+constexpr uint16_t kLandColor = 0xff99;
+
+uint16_t
+Rgb565ToGrayscale(uint16_t pixel)
+{
+    // https://stackoverflow.com/a/71086522, rgb565 to grayscale
+    auto r = (pixel >> 10) & 0x3E; // 6-bit Red Component
+    auto g = (pixel >> 5) & 0x3F;  // 6-bit Green Component
+    auto b = (pixel << 1) & 0x3E;  // 6-bit Blue Component
+
+    auto luma = (r * 218) + (g * 732) + (b * 74); // Wx*1024/10000.
+    luma = (luma >> 10) + ((luma >> 9) & 1);      // 6-bit Luminance value.
+
+    return ((luma & 0x3E) << 10) | (luma << 5) | (luma >> 1);
+}
+
+// Nearest neighbor, every factor:th pixel
+void
+DrawScaled(const IndexedTile& tile,
+           uint16_t* frame_buffer,
+           unsigned width,
+           unsigned factor,
+           const Point& at,
+           const TileStyle& style)
+{
+    // Clip to the frame buffer
+    const auto size = static_cast<int>(kTileSize / factor);
+    const auto x_start = std::max(0, -at.x);
+    const auto x_end = std::min(size, static_cast<int>(width) - at.x);
+    const auto y_start = std::max(0, -at.y);
+    const auto y_end = std::min(size, hal::kDisplayHeight - at.y);
+
+    if (x_start >= x_end || y_start >= y_end)
+    {
+        return;
+    }
+
+    StyledPalette palette(tile.palette, style);
+    for (auto y = y_start; y < y_end; y++)
+    {
+        auto src = tile.pixels.data() + y * factor * kTileSize + x_start * factor;
+        auto dst = frame_buffer + (at.y + y) * width + at.x;
+
+        // The hatch pattern is in full size tile pixels
+        palette.ExpandRow(src, (x_start + y) * factor, {dst + x_start, dst + x_end}, factor);
+    }
+}
+
+} // namespace
+
+StyledPalette::StyledPalette(std::span<const uint16_t, 256> palette, const TileStyle& style)
+    : m_colors(palette.data())
+    , m_hatched(style.grayscale)
+{
+    if (!style.grayscale)
+    {
+        return;
+    }
+
+    // Remap the palette instead of the pixels. The hatch lines use a palette with the land
+    // replaced by the hatch color
+    for (auto i = 0u; i < m_grayscale.size(); i++)
+    {
+        m_grayscale[i] = Rgb565ToGrayscale(palette[i]);
+        m_hatched_colors[i] = palette[i] == kLandColor ? style.hatch_color : m_grayscale[i];
+    }
+    m_colors = m_grayscale.data();
+}
+
+void
+StyledPalette::ExpandRow(const uint8_t* src,
+                         unsigned phase,
+                         std::span<uint16_t> dst,
+                         unsigned factor) const
+{
+    if (m_hatched)
+    {
+        HatchedIndexedToRgb565Row(src, m_colors, m_hatched_colors.data(), phase, dst, factor);
+    }
+    else
+    {
+        IndexedToRgb565Row(src, m_colors, dst, factor);
+    }
+}
+
+void
+IndexedTile::Blit(uint16_t* frame_buffer, const Point& at, const TileStyle& style) const
+{
+    DrawScaled(*this, frame_buffer, hal::kDisplayWidth, 1, at, style);
+}
+
+void
+IndexedTile::ZoomedBlit(uint16_t* frame_buffer,
+                        unsigned width,
+                        unsigned factor,
+                        const Point& at,
+                        const TileStyle& style) const
+{
+    DrawScaled(*this, frame_buffer, width, factor, at, style);
+}
@@ -0,0 +1,786 @@
+#include "palette_png_decoder.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+
+constexpr auto kWindowSize = 32 * 1024u;
+// The filter type byte, then the palette indices
+constexpr auto kRowBytes = kTileSize + 1;
+// Read from flash in chunks of this size
+constexpr auto kReadBufferSize = 512u;
+
+constexpr auto kMaxCodeLength = 15;
+// Codes of up to this length are decoded with a single table lookup
+constexpr auto kFastBits = 9;
+constexpr auto kLiteralLengthCodes = 288;
+constexpr auto kDistanceCodes = 32;
+constexpr auto kCodeLengthCodes = 19;
+constexpr auto kEndOfBlock = 256;
+
+constexpr std::array<uint8_t, 8> kSignature {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+constexpr std::array<uint16_t, 29> kLengthBase {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                                15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                                67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::array<uint8_t, 29> kLengthExtraBits {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                                    1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                                    4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::array<uint16_t, 30> kDistanceBase {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr std::array<uint8_t, 30> kDistanceExtraBits {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,
+                                                      4, 4, 5, 5, 6, 6, 7, 7,  8,  8,
+                                                      9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr std::array<uint8_t, kCodeLengthCodes> kCodeLengthOrder {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+constexpr uint32_t
+ChunkType(const char (&name)[5])
+{
+    return (name[0] << 24) | (name[1] << 16) | (name[2] << 8) | name[3];
+}
+
+// Same as PNGdec
+uint16_t
+RgbToRgb565(const uint8_t* rgb)
+{
+    return ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+}
+
+// A canonical Huffman code, as in RFC 1951
+struct Huffman
+{
+    // The number of codes per length, and the symbols ordered by code
+    std::array<uint16_t, kMaxCodeLength + 1> counts;
+    std::array<uint16_t, kLiteralLengthCodes> symbols;
+    // Indexed by the next kFastBits input bits: symbol << 4 | length, or 0 for longer codes
+    std::array<uint16_t, 1 << kFastBits> fast;
+
+    bool Build(const uint8_t* lengths, unsigned n)
+    {
+        counts.fill(0);
+        for (auto i = 0u; i < n; i++)
+        {
+            counts[lengths[i]]++;
+        }
+        counts[0] = 0;
+
+        // Over-subscribed codes are corrupt. Incomplete ones are allowed (single distance code)
+        auto left = 1;
+        for (auto length = 1; length <= kMaxCodeLength; length++)
+        {
+            left = left * 2 - counts[length];
+            if (left < 0)
+            {
+                return false;
+            }
+        }
+
+        std::array<uint16_t, kMaxCodeLength + 2> offsets;
+        offsets[1] = 0;
+        for (auto length = 1; length <= kMaxCodeLength; length++)
+        {
+            offsets[length + 1] = offsets[length] + counts[length];
+        }
+        for (auto symbol = 0u; symbol < n; symbol++)
+        {
+            if (lengths[symbol] != 0)
+            {
+                symbols[offsets[lengths[symbol]]++] = symbol;
+            }
+        }
+
+        // The codes are sent most significant bit first, so the table is bit reversed
+        fast.fill(0);
+        auto code = 0u;
+        auto index = 0u;
+        for (auto length = 1; length <= kFastBits; length++)
+        {
+            for (auto i = 0u; i < counts[length]; i++, code++, index++)
+            {
+                auto reversed = 0u;
+                for (auto bit = 0; bit < length; bit++)
+                {
+                    reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+                }
+
+                for (auto entry = reversed; entry < fast.size(); entry += 1u << length)
+                {
+                    fast[entry] = (symbols[index] << 4) | length;
+                }
+            }
+            code <<= 1;
+        }
+
+        return true;
+    }
+};
+
+// PNG row filters, for one byte per pixel. prior is the previous unfiltered row
+void
+UnfilterSub(const uint8_t* src, uint8_t* dst)
+{
+    dst[0] = src[0];
+    for (auto x = 1u; x < kTileSize; x++)
+    {
+        dst[x] = src[x] + dst[x - 1];
+    }
+}
+
+void
+UnfilterUp(const uint8_t* src, const uint8_t* prior, uint8_t* dst)
+{
+    for (auto x = 0u; x < kTileSize; x++)
+    {
+        dst[x] = src[x] + prior[x];
+    }
+}
+
+void
+UnfilterAverage(const uint8_t* src, const uint8_t* prior, uint8_t* dst)
+{
+    dst[0] = src[0] + prior[0] / 2;
+    for (auto x = 1u; x < kTileSize; x++)
+    {
+        dst[x] = src[x] + (dst[x - 1] + prior[x]) / 2;
+    }
+}
+
+void
+UnfilterPaeth(const uint8_t* src, const uint8_t* prior, uint8_t* dst)
+{
+    // The left and upper left pixels are zero for the first one
+    dst[0] = src[0] + prior[0];
+    for (auto x = 1u; x < kTileSize; x++)
+    {
+        const int a = dst[x - 1];
+        const int b = prior[x];
+        const int c = prior[x - 1];
+        const auto pa = std::abs(b - c);
+        const auto pb = std::abs(a - c);
+        const auto pc = std::abs(a + b - 2 * c);
+
+        dst[x] = src[x] + (pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+    }
+}
+
+} // namespace
+
+struct PalettePngDecoder::State
+{
+    enum class Block
+    {
+        kHeader,
+        kStored,
+        kCompressed,
+    };
+
+    // The input, either all of it in memory, or read from flash to the buffer
+    hal::IFlash* flash;
+    const uint8_t* src;
+    size_t size;
+    size_t read_offset;
+    const uint8_t* data;
+    size_t data_size;
+    size_t data_offset;
+    std::array<uint8_t, kReadBufferSize> buffer;
+
+    // The remaining bytes of the current IDAT chunk
+    uint32_t idat_left;
+    bool idat_done;
+
+    uint64_t bits;
+    unsigned bit_count;
+    // Zero bytes fed after the end of the data, which must not be consumed
+    unsigned padding;
+
+    Block block;
+    bool last_block;
+    uint32_t stored_left;
+    const Huffman* literals;
+    const Huffman* distances;
+
+    // The inflated stream, i.e., the filtered rows
+    uint32_t written;
+    std::array<uint8_t, kWindowSize> window;
+
+    Huffman fixed_literals;
+    Huffman fixed_distances;
+    Huffman dynamic_literals;
+    Huffman dynamic_distances;
+    Huffman code_lengths;
+
+    std::array<uint8_t, kRowBytes> filtered;
+    std::array<std::array<uint8_t, kTileSize>, 2> rows;
+
+    State()
+    {
+        std::array<uint8_t, kLiteralLengthCodes> lengths;
+
+        std::fill_n(lengths.begin(), 144, 8);
+        std::fill_n(lengths.begin() + 144, 112, 9);
+        std::fill_n(lengths.begin() + 256, 24, 7);
+        std::fill_n(lengths.begin() + 280, 8, 8);
+        fixed_literals.Build(lengths.data(), kLiteralLengthCodes);
+
+        std::fill_n(lengths.begin(), 30, 5);
+        fixed_distances.Build(lengths.data(), 30);
+    }
+
+    void Reset(hal::IFlash* from, const uint8_t* at, size_t length)
+    {
+        flash = from;
+        src = at;
+        size = length;
+        read_offset = flash ? 0 : length;
+        data = flash ? buffer.data() : at;
+        data_size = flash ? 0 : length;
+        data_offset = 0;
+
+        idat_left = 0;
+        idat_done = false;
+        bits = 0;
+        bit_count = 0;
+        padding = 0;
+        block = Block::kHeader;
+        last_block = false;
+        written = 0;
+    }
+
+    // The next byte of the file, chunk headers included
+    bool ReadByte(uint8_t& out)
+    {
+        if (data_offset == data_size)
+        {
+            if (read_offset == size)
+            {
+                return false;
+            }
+
+            data_size = std::min<size_t>(kReadBufferSize, size - read_offset);
+            flash->Read(src + read_offset, {buffer.data(), data_size});
+            read_offset += data_size;
+            data_offset = 0;
+        }
+
+        out = data[data_offset++];
+        return true;
+    }
+
+    bool ReadUint32(uint32_t& out)
+    {
+        out = 0;
+        for (auto i = 0; i < 4; i++)
+        {
+            uint8_t byte;
+            if (!ReadByte(byte))
+            {
+                return false;
+            }
+            out = (out << 8) | byte;
+        }
+
+        return true;
+    }
+
+    bool Skip(uint32_t count)
+    {
+        uint8_t byte;
+        while (count-- > 0)
+        {
+            if (!ReadByte(byte))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // The zlib stream, over consecutive IDAT chunks
+    bool ReadIdatByte(uint8_t& out)
+    {
+        while (idat_left == 0)
+        {
+            uint32_t length;
+            uint32_t type;
+
+            // The CRC of the previous chunk, then the next header
+            if (idat_done || !Skip(4) || !ReadUint32(length) || !ReadUint32(type) ||
+                type != ChunkType("IDAT"))
+            {
+                idat_done = true;
+                return false;
+            }
+            idat_left = length;
+        }
+
+        idat_left--;
+        return ReadByte(out);
+    }
+
+    void Refill()
+    {
+        while (bit_count <= 56)
+        {
+            uint8_t byte = 0;
+            if (!ReadIdatByte(byte))
+            {
+                padding++;
+            }
+            bits |= static_cast<uint64_t>(byte) << bit_count;
+            bit_count += 8;
+        }
+    }
+
+    // Past the end of the data
+    bool Overrun() const
+    {
+        return bit_count < padding * 8;
+    }
+
+    uint32_t GetBits(unsigned count)
+    {
+        if (bit_count < count)
+        {
+            Refill();
+        }
+
+        const auto out = static_cast<uint32_t>(bits & ((1ull << count) - 1));
+        bits >>= count;
+        bit_count -= count;
+
+        return out;
+    }
+
+    int DecodeSymbol(const Huffman& huffman)
+    {
+        if (bit_count < kMaxCodeLength)
+        {
+            Refill();
+        }
+
+        if (auto entry = huffman.fast[bits & ((1u << kFastBits) - 1)]; entry != 0)
+        {
+            const auto length = entry & 0xf;
+
+            bits >>= length;
+            bit_count -= length;
+            return entry >> 4;
+        }
+
+        // Longer codes, bit by bit
+        auto code = 0;
+        auto first = 0;
+        auto index = 0;
+        for (auto length = 1; length <= kMaxCodeLength; length++)
+        {
+            code |= (bits >> (length - 1)) & 1;
+
+            const int count = huffman.counts[length];
+            if (code - count < first)
+            {
+                bits >>= length;
+                bit_count -= length;
+                return huffman.symbols[index + code - first];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        return -1;
+    }
+
+    void Put(uint8_t value)
+    {
+        window[written++ % kWindowSize] = value;
+    }
+
+    bool ReadBlockHeader()
+    {
+        if (last_block)
+        {
+            // The stream ended before the image
+            return false;
+        }
+
+        last_block = GetBits(1);
+        switch (GetBits(2))
+        {
+        case 0:
+        {
+            // Stored, from the next byte boundary
+            GetBits(bit_count % 8);
+
+            const auto length = GetBits(16);
+            if ((GetBits(16) ^ 0xffff) != length)
+            {
+                return false;
+            }
+            stored_left = length;
+            block = Block::kStored;
+            break;
+        }
+        case 1:
+            literals = &fixed_literals;
+            distances = &fixed_distances;
+            block = Block::kCompressed;
+            break;
+        case 2:
+            if (!ReadDynamicTables())
+            {
+                return false;
+            }
+            literals = &dynamic_literals;
+            distances = &dynamic_distances;
+            block = Block::kCompressed;
+            break;
+        default:
+            return false;
+        }
+
+        return !Overrun();
+    }
+
+    bool ReadDynamicTables()
+    {
+        const auto literal_count = GetBits(5) + 257;
+        const auto distance_count = GetBits(5) + 1;
+        const auto code_length_count = GetBits(4) + 4;
+
+        if (literal_count > 286 || distance_count > 30)
+        {
+            return false;
+        }
+
+        std::array<uint8_t, kLiteralLengthCodes + kDistanceCodes> lengths {};
+        for (auto i = 0u; i < code_length_count; i++)
+        {
+            lengths[kCodeLengthOrder[i]] = GetBits(3);
+        }
+        if (!code_lengths.Build(lengths.data(), kCodeLengthCodes))
+        {
+            return false;
+        }
+
+        // The literal/length and distance code lengths, as one sequence
+        auto index = 0u;
+        while (index < literal_count + distance_count)
+        {
+            auto symbol = DecodeSymbol(code_lengths);
+            auto repeat = 0u;
+            auto value = 0;
+
+            if (symbol < 0 || Overrun())
+            {
+                return false;
+            }
+            if (symbol < 16)
+            {
+                lengths[index++] = symbol;
+                continue;
+            }
+
+            if (symbol == 16)
+            {
+                if (index == 0)
+                {
+                    return false;
+                }
+                value = lengths[index - 1];
+                repeat = 3 + GetBits(2);
+            }
+            else if (symbol == 17)
+            {
+                repeat = 3 + GetBits(3);
+            }
+            else
+            {
+                repeat = 11 + GetBits(7);
+            }
+
+            if (index + repeat > literal_count + distance_count)
+            {
+                return false;
+            }
+            std::fill_n(lengths.begin() + index, repeat, value);
+            index += repeat;
+        }
+
+        if (lengths[kEndOfBlock] == 0)
+        {
+            return false;
+        }
+
+        return dynamic_literals.Build(lengths.data(), literal_count) &&
+               dynamic_distances.Build(lengths.data() + literal_count, distance_count);
+    }
+
+    // Inflate until at least @a target bytes have been written. Matches can overshoot it
+    bool Inflate(uint32_t target)
+    {
+        while (written < target)
+        {
+            if (block == Block::kHeader)
+            {
+                if (!ReadBlockHeader())
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            if (block == Block::kStored)
+            {
+                while (stored_left > 0 && written < target)
+                {
+                    Put(GetBits(8));
+                    stored_left--;
+                }
+                if (stored_left == 0)
+                {
+                    block = Block::kHeader;
+                }
+                if (Overrun())
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            while (written < target)
+            {
+                const auto symbol = DecodeSymbol(*literals);
+
+                if (symbol < 0)
+                {
+                    return false;
+                }
+                if (symbol < kEndOfBlock)
+                {
+                    Put(symbol);
+                    continue;
+                }
+                if (symbol == kEndOfBlock)
+                {
+                    block = Block::kHeader;
+                    break;
+                }
+
+                const auto length_code = symbol - kEndOfBlock - 1;
+                if (length_code >= static_cast<int>(kLengthBase.size()))
+                {
+                    return false;
+                }
+                const auto length =
+                    kLengthBase[length_code] + GetBits(kLengthExtraBits[length_code]);
+
+                const auto distance_code = DecodeSymbol(*distances);
+                if (distance_code < 0 || distance_code >= static_cast<int>(kDistanceBase.size()))
+                {
+                    return false;
+                }
+                const auto distance =
+                    kDistanceBase[distance_code] + GetBits(kDistanceExtraBits[distance_code]);
+                if (distance > written)
+                {
+                    return false;
+                }
+
+                // Byte by byte, since the source and destination can overlap
+                for (auto i = 0u; i < length; i++)
+                {
+                    Put(window[(written - distance) % kWindowSize]);
+                }
+            }
+
+            if (Overrun())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+PalettePngDecoder::PalettePngDecoder()
+    : m_state(std::make_unique<State>())
+{
+}
+
+PalettePngDecoder::~PalettePngDecoder()
+{
+}
+
+PalettePngDecoder::Result
+PalettePngDecoder::Decode(std::span<const uint8_t> data,
+                          std::span<uint16_t, 256> palette,
+                          OnRow on_row,
+                          void* user)
+{
+    m_state->Reset(nullptr, data.data(), data.size());
+
+    return DecodeRows(palette, on_row, user);
+}
+
+PalettePngDecoder::Result
+PalettePngDecoder::Decode(hal::IFlash& flash,
+                          const uint8_t* src,
+                          size_t size,
+                          std::span<uint16_t, 256> palette,
+                          OnRow on_row,
+                          void* user)
+{
+    m_state->Reset(&flash, src, size);
+
+    return DecodeRows(palette, on_row, user);
+}
+
+PalettePngDecoder::Result
+PalettePngDecoder::DecodeRows(std::span<uint16_t, 256> palette, OnRow on_row, void* user)
+{
+    auto& state = *m_state;
+
+    // The signature and IHDR, which decide if it's a tile
+    std::array<uint8_t, kSignature.size() + 8 + 13> header;
+    for (auto& byte : header)
+    {
+        if (!state.ReadByte(byte))
+        {
+            return Result::kUnsupported;
+        }
+    }
+
+    auto be32 = [&header](unsigned offset) {
+        return (static_cast<uint32_t>(header[offset]) << 24) | (header[offset + 1] << 16) |
+               (header[offset + 2] << 8) | header[offset + 3];
+    };
+    const auto ihdr = header.data() + kSignature.size() + 8;
+    if (!std::equal(kSignature.begin(), kSignature.end(), header.begin()) ||
+        be32(kSignature.size()) != 13 || be32(kSignature.size() + 4) != ChunkType("IHDR") ||
+        be32(kSignature.size() + 8) != kTileSize || be32(kSignature.size() + 12) != kTileSize)
+    {
+        return Result::kUnsupported;
+    }
+    // 8 bits, palette, deflate, adaptive filtering, not interlaced
+    if (ihdr[8] != 8 || ihdr[9] != 3 || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0)
+    {
+        return Result::kUnsupported;
+    }
+
+    // Chunks until the first IDAT. The CRC of the IHDR is skipped first
+    auto has_palette = false;
+    std::ranges::fill(palette, 0);
+    if (!state.Skip(4))
+    {
+        return Result::kCorrupt;
+    }
+    while (true)
+    {
+        uint32_t length;
+        uint32_t type;
+        if (!state.ReadUint32(length) || !state.ReadUint32(type))
+        {
+            return Result::kCorrupt;
+        }
+
+        if (type == ChunkType("IDAT"))
+        {
+            state.idat_left = length;
+            break;
+        }
+        if (type == ChunkType("PLTE"))
+        {
+            if (length % 3 != 0 || length / 3 > palette.size())
+            {
+                return Result::kCorrupt;
+            }
+
+            for (auto i = 0u; i < length / 3; i++)
+            {
+                std::array<uint8_t, 3> rgb;
+                if (!state.ReadByte(rgb[0]) || !state.ReadByte(rgb[1]) || !state.ReadByte(rgb[2]))
+                {
+                    return Result::kCorrupt;
+                }
+                palette[i] = RgbToRgb565(rgb.data());
+            }
+            has_palette = true;
+            length = 0;
+        }
+        else if (type == ChunkType("IEND"))
+        {
+            return Result::kCorrupt;
+        }
+
+        // The rest of the chunk, and its CRC
+        if (!state.Skip(length + 4))
+        {
+            return Result::kCorrupt;
+        }
+    }
+
+    if (!has_palette)
+    {
+        return Result::kUnsupported;
+    }
+
+    // The zlib header: deflate, at most a 32 KiB window, no preset dictionary
+    const auto cmf = state.GetBits(8);
+    const auto flags = state.GetBits(8);
+    if ((cmf & 0x0f) != 8 || (cmf >> 4) > 7 || (flags & 0x20) || (cmf * 256 + flags) % 31 != 0)
+    {
+        return Result::kUnsupported;
+    }
+
+    static constexpr std::array<uint8_t, kTileSize> kZeroRow {};
+    const uint8_t* prior = kZeroRow.data();
+
+    for (auto y = 0u; y < kTileSize; y++)
+    {
+        if (!state.Inflate((y + 1) * kRowBytes))
+        {
+            return Result::kCorrupt;
+        }
+
+        // The row can wrap around the end of the window
+        const auto start = (y * kRowBytes) % kWindowSize;
+        const auto first = std::min<size_t>(kRowBytes, kWindowSize - start);
+        std::memcpy(state.filtered.data(), state.window.data() + start, first);
+        std::memcpy(state.filtered.data() + first, state.window.data(), kRowBytes - first);
+
+        auto src = state.filtered.data() + 1;
+        auto dst = state.rows[y % 2].data();
+        switch (state.filtered[0])
+        {
+        case 0:
+            std::memcpy(dst, src, kTileSize);
+            break;
+        case 1:
+            UnfilterSub(src, dst);
+            break;
+        case 2:
+            UnfilterUp(src, prior, dst);
+            break;
+        case 3:
+            UnfilterAverage(src, prior, dst);
+            break;
+        case 4:
+            UnfilterPaeth(src, prior, dst);
+            break;
+        default:
+            return Result::kCorrupt;
+        }
+
+        on_row(user, y, dst);
+        prior = dst;
+    }
+
+    return Result::kDecoded;
+}
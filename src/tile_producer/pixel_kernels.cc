@@ -0,0 +1,196 @@
+#include "pixel_kernels.hh"
+
+#include <array>
+#include <cstring>
+
+namespace
+{
+
+// The right-slanted hatch pattern, in source pixels
+constexpr auto kHatchPeriod = 6u;
+constexpr auto kHatchWidth = 2u;
+
+constexpr uint8_t kOpaque = 255;
+constexpr uint8_t kTransparent = 0;
+
+// The 5/6-bit color components scaled to 8 bits, the same as (c * 255) / max
+template <unsigned Bits>
+constexpr auto
+MakeScaleTable()
+{
+    constexpr auto kMax = (1u << Bits) - 1;
+    std::array<uint8_t, kMax + 1> out {};
+
+    for (auto i = 0u; i <= kMax; i++)
+    {
+        out[i] = (i * 255) / kMax;
+    }
+
+    return out;
+}
+
+constexpr auto k5To8 = MakeScaleTable<5>();
+constexpr auto k6To8 = MakeScaleTable<6>();
+
+// Whether a pixel at a phase in the hatch pattern is on a line
+constexpr auto
+MakeHatchTable()
+{
+    std::array<bool, kHatchPeriod> out {};
+
+    for (auto i = 0u; i < kHatchPeriod; i++)
+    {
+        out[i] = i < kHatchWidth;
+    }
+
+    return out;
+}
+
+constexpr auto kHatchLine = MakeHatchTable();
+
+} // namespace
+
+void
+IndexedToRgb565Row(const uint8_t* src,
+                   const uint16_t* palette,
+                   std::span<uint16_t> dst,
+                   unsigned step)
+{
+    auto out = dst.data();
+    const auto count = dst.size();
+    auto i = 0u;
+
+    if (step == 1)
+    {
+        // Four indices per load. Both the host and the ESP32 are little endian
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32_t indices;
+
+            memcpy(&indices, src + i, sizeof(indices));
+            out[i] = palette[indices & 0xff];
+            out[i + 1] = palette[(indices >> 8) & 0xff];
+            out[i + 2] = palette[(indices >> 16) & 0xff];
+            out[i + 3] = palette[indices >> 24];
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        out[i] = palette[src[i * step]];
+    }
+}
+
+void
+IndexedToRgb565RowReference(const uint8_t* src,
+                            const uint16_t* palette,
+                            std::span<uint16_t> dst,
+                            unsigned step)
+{
+    for (auto x = 0u; x < dst.size(); x++)
+    {
+        dst[x] = palette[src[x * step]];
+    }
+}
+
+void
+HatchedIndexedToRgb565Row(const uint8_t* src,
+                          const uint16_t* palette,
+                          const uint16_t* hatched_palette,
+                          unsigned phase,
+                          std::span<uint16_t> dst,
+                          unsigned step)
+{
+    // The pattern repeats every kHatchPeriod pixels for any step, so select the palette of
+    // each of them once, and then unroll by the period
+    std::array<const uint16_t*, kHatchPeriod> palettes;
+    for (auto i = 0u; i < kHatchPeriod; i++)
+    {
+        palettes[i] = kHatchLine[(phase + i * step) % kHatchPeriod] ? hatched_palette : palette;
+    }
+
+    auto out = dst.data();
+    const auto count = dst.size();
+    auto x = 0u;
+
+    for (; x + kHatchPeriod <= count; x += kHatchPeriod)
+    {
+        auto row = src + x * step;
+
+        out[x] = palettes[0][row[0]];
+        out[x + 1] = palettes[1][row[step]];
+        out[x + 2] = palettes[2][row[2 * step]];
+        out[x + 3] = palettes[3][row[3 * step]];
+        out[x + 4] = palettes[4][row[4 * step]];
+        out[x + 5] = palettes[5][row[5 * step]];
+    }
+
+    for (auto i = 0u; x < count; x++, i++)
+    {
+        out[x] = palettes[i][src[x * step]];
+    }
+}
+
+void
+HatchedIndexedToRgb565RowReference(const uint8_t* src,
+                                   const uint16_t* palette,
+                                   const uint16_t* hatched_palette,
+                                   unsigned phase,
+                                   std::span<uint16_t> dst,
+                                   unsigned step)
+{
+    for (auto x = 0u; x < dst.size(); x++)
+    {
+        auto index = src[x * step];
+
+        if ((phase + x * step) % kHatchPeriod < kHatchWidth)
+        {
+            dst[x] = hatched_palette[index];
+        }
+        else
+        {
+            dst[x] = palette[index];
+        }
+    }
+}
+
+void
+Rgb565ToArgb8888Row(std::span<const uint16_t> src,
+                    uint8_t* dst,
+                    std::optional<uint16_t> transparent_color)
+{
+    // Outside the valid range if there's no transparent color
+    const auto transparent = transparent_color ? uint32_t {*transparent_color} : 0x10000u;
+
+    for (auto pixel : src)
+    {
+        dst[0] = k5To8[pixel & 0x1f];
+        dst[1] = k6To8[(pixel >> 5) & 0x3f];
+        dst[2] = k5To8[pixel >> 11];
+        dst[3] = pixel == transparent ? kTransparent : kOpaque;
+        dst += 4;
+    }
+}
+
+void
+Rgb565ToArgb8888RowReference(std::span<const uint16_t> src,
+                             uint8_t* dst,
+                             std::optional<uint16_t> transparent_color)
+{
+    auto offset = 0u;
+
+    for (auto pixel : src)
+    {
+        auto alpha_value = pixel == transparent_color ? kTransparent : kOpaque;
+
+        auto b = pixel >> 11;
+        auto g = (pixel >> 5) & 0x3f;
+        auto r = pixel & 0x1f;
+
+        // RGB565 -> ARGB888
+        dst[offset++] = (r * 255) / 31;
+        dst[offset++] = (g * 255) / 63;
+        dst[offset++] = (b * 255) / 31;
+        dst[offset++] = alpha_value;
+    }
+}
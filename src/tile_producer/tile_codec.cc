@@ -0,0 +1,14 @@
+#include "tile_codec.hh"
+
+#include <algorithm>
+
+bool
+DecodePaletteRleTile(std::span<const uint8_t> data,
+                     std::span<uint8_t> dst,
+                     std::span<uint16_t> palette)
+{
+    return ForEachPaletteRleRun(
+        data, dst.size(), palette, [dst](size_t offset, unsigned length, uint8_t index) {
+            std::fill_n(dst.begin() + offset, length, index);
+        });
+}
@@ -0,0 +1,447 @@
+#include "tile_decoder.hh"
+
+#include "tile_codec.hh"
+
+#include <PNGdec.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+
+struct DecodeHelperIndexed
+{
+    DecodeHelperIndexed(PNG& png, IndexedTile& tile, uint16_t* line_buffer)
+        : png(png)
+        , tile(tile)
+        , line_buffer(line_buffer)
+    {
+    }
+
+    DecodeHelperIndexed() = delete;
+
+    PNG& png;
+    IndexedTile& tile;
+
+    // For non-palette PNGs, where the palette is built while decoding
+    uint16_t* line_buffer;
+    unsigned palette_size {0};
+};
+
+struct DecodeHelperScaled
+{
+    PNG& png;
+    unsigned factor;
+    std::span<uint16_t> dst;
+    const TileStyle& style;
+    std::array<uint16_t, 256>& palette;
+    std::optional<StyledPalette>& styled_palette;
+    uint8_t* index_row;
+    uint16_t* line_buffer;
+
+    // Expand a row of palette indices, if it's one of the scaled rows
+    void ExpandRow(const uint8_t* src, unsigned y)
+    {
+        if (y % factor != 0)
+        {
+            return;
+        }
+
+        const auto size = kTileSize / factor;
+        styled_palette->ExpandRow(src, y, dst.subspan(y / factor * size, size), factor);
+    }
+};
+
+// Same as PNGdec
+uint16_t
+RgbToRgb565(const uint8_t* rgb)
+{
+    return ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+}
+
+// 1, 2, 4 or 8 bits per pixel, the leftmost pixel in the high bits
+void
+UnpackIndices(const PNGDRAW* pDraw, uint8_t* dst)
+{
+    const auto bpp = pDraw->iBpp;
+    const auto mask = (1 << bpp) - 1;
+
+    for (auto x = 0; x < pDraw->iWidth; x++)
+    {
+        auto bit = x * bpp;
+        auto shift = 8 - bpp - bit % 8;
+
+        dst[x] = (pDraw->pPixels[bit / 8] >> shift) & mask;
+    }
+}
+
+int
+PngDrawIndexed(PNGDRAW* pDraw)
+{
+    auto helper = static_cast<DecodeHelperIndexed*>(pDraw->pUser);
+    auto& tile = helper->tile;
+    auto dst = tile.pixels.data() + pDraw->y * kTileSize;
+
+    if (pDraw->iPixelType == PNG_PIXEL_INDEXED)
+    {
+        if (pDraw->y == 0)
+        {
+            for (auto i = 0u; i < tile.palette.size(); i++)
+            {
+                tile.palette[i] = RgbToRgb565(pDraw->pPalette + i * 3);
+            }
+        }
+
+        UnpackIndices(pDraw, dst);
+
+        return 1;
+    }
+
+    // Not palettized, so build the palette while decoding
+    helper->png.getLineAsRGB565(
+        pDraw, helper->line_buffer, PNG_RGB565_LITTLE_ENDIAN, 0xffffffff);
+
+    for (auto x = 0; x < pDraw->iWidth; x++)
+    {
+        const auto pixel = helper->line_buffer[x];
+        const auto palette_end = tile.palette.begin() + helper->palette_size;
+        auto it = std::find(tile.palette.begin(), palette_end, pixel);
+
+        if (it == palette_end)
+        {
+            if (helper->palette_size == tile.palette.size())
+            {
+                // Too many colors
+                return 0;
+            }
+            *it = pixel;
+            helper->palette_size++;
+        }
+
+        dst[x] = std::distance(tile.palette.begin(), it);
+    }
+
+    return 1;
+}
+
+int
+PngDrawScaled(PNGDRAW* pDraw)
+{
+    auto helper = static_cast<DecodeHelperScaled*>(pDraw->pUser);
+
+    if (pDraw->iPixelType == PNG_PIXEL_INDEXED)
+    {
+        if (pDraw->y == 0)
+        {
+            for (auto i = 0u; i < helper->palette.size(); i++)
+            {
+                helper->palette[i] = RgbToRgb565(pDraw->pPalette + i * 3);
+            }
+            helper->styled_palette.emplace(helper->palette, helper->style);
+        }
+
+        if (pDraw->y % helper->factor == 0)
+        {
+            auto src = pDraw->pPixels;
+            if (pDraw->iBpp != 8)
+            {
+                UnpackIndices(pDraw, helper->index_row);
+                src = helper->index_row;
+            }
+            helper->ExpandRow(src, pDraw->y);
+        }
+
+        return 1;
+    }
+
+    if (pDraw->y % helper->factor != 0)
+    {
+        return 1;
+    }
+
+    // Not palettized, sampled as is, i.e., without the color mode style
+    helper->png.getLineAsRGB565(
+        pDraw, helper->line_buffer, PNG_RGB565_LITTLE_ENDIAN, 0xffffffff);
+
+    const auto size = kTileSize / helper->factor;
+    auto dst = helper->dst.subspan(pDraw->y / helper->factor * size, size);
+    for (auto x = 0u; x < size; x++)
+    {
+        dst[x] = helper->line_buffer[x * helper->factor];
+    }
+
+    return 1;
+}
+
+// The PalettePngDecoder rows, straight to the tile
+void
+PaletteRowIndexed(void* user, unsigned y, const uint8_t* indices)
+{
+    auto tile = static_cast<IndexedTile*>(user);
+
+    std::memcpy(tile->pixels.data() + y * kTileSize, indices, kTileSize);
+}
+
+void
+PaletteRowScaled(void* user, unsigned y, const uint8_t* indices)
+{
+    auto helper = static_cast<DecodeHelperScaled*>(user);
+
+    if (y == 0)
+    {
+        helper->styled_palette.emplace(helper->palette, helper->style);
+    }
+    helper->ExpandRow(indices, y);
+}
+
+// The PNGdec file callbacks for DecodeFromFlash. The stream is passed as the file name
+struct FlashStream
+{
+    hal::IFlash& flash;
+    const uint8_t* src;
+    int32_t size;
+};
+
+void*
+FlashOpen(const char* name, int32_t* size)
+{
+    auto stream = reinterpret_cast<FlashStream*>(const_cast<char*>(name));
+
+    *size = stream->size;
+    return stream;
+}
+
+void
+FlashClose(void*)
+{
+}
+
+// Same as PNGdec readFLASH, but through IFlash
+int32_t
+FlashRead(PNGFILE* file, uint8_t* dst, int32_t length)
+{
+    auto stream = static_cast<FlashStream*>(file->fHandle);
+    auto to_read = std::min(length, file->iSize - file->iPos);
+
+    if (to_read <= 0)
+    {
+        return 0;
+    }
+
+    stream->flash.Read(stream->src + file->iPos, {dst, static_cast<size_t>(to_read)});
+    file->iPos += to_read;
+
+    return to_read;
+}
+
+int32_t
+FlashSeek(PNGFILE* file, int32_t position)
+{
+    file->iPos = std::clamp(position, 0, file->iSize);
+
+    return file->iPos;
+}
+
+int
+OpenFromFlash(PNG& png, FlashStream& stream, PNG_DRAW_CALLBACK* draw)
+{
+    return png.open(reinterpret_cast<const char*>(&stream),
+                    FlashOpen,
+                    FlashClose,
+                    FlashRead,
+                    FlashSeek,
+                    draw);
+}
+
+} // namespace
+
+TileDecoder::TileDecoder(size_t max_tile_size, bool palette_png_decoder)
+    : m_png(std::make_unique<PNG>())
+    , m_palette_png(palette_png_decoder ? std::make_unique<PalettePngDecoder>() : nullptr)
+    , m_staging(std::make_unique<uint8_t[]>(max_tile_size))
+    , m_staging_size(max_tile_size)
+{
+}
+
+TileDecoder::~TileDecoder()
+{
+}
+
+std::span<uint8_t>
+TileDecoder::GetStagingBuffer(size_t size)
+{
+    assert(size <= m_staging_size);
+
+    return {m_staging.get(), std::min(size, m_staging_size)};
+}
+
+bool
+TileDecoder::Decode(TileCodec codec, std::span<const uint8_t> data, IndexedTile& tile)
+{
+    if (codec == TileCodec::kPaletteRle)
+    {
+        return DecodePaletteRleTile(data, tile.pixels, tile.palette);
+    }
+    if (codec != TileCodec::kPng)
+    {
+        return false;
+    }
+
+    if (m_palette_png)
+    {
+        auto result = m_palette_png->Decode(data, tile.palette, PaletteRowIndexed, &tile);
+        if (result != PalettePngDecoder::Result::kUnsupported)
+        {
+            return result == PalettePngDecoder::Result::kDecoded;
+        }
+    }
+
+    auto rc = m_png->openFLASH(const_cast<uint8_t*>(data.data()), data.size(), PngDrawIndexed);
+    if (rc != PNG_SUCCESS)
+    {
+        return false;
+    }
+
+    return DecodePng(tile);
+}
+
+bool
+TileDecoder::DecodeFromFlash(
+    TileCodec codec, hal::IFlash& flash, const uint8_t* src, size_t size, IndexedTile& tile)
+{
+    if (codec != TileCodec::kPng)
+    {
+        auto staging = GetStagingBuffer(size);
+
+        flash.Read(src, staging);
+        return Decode(codec, staging, tile);
+    }
+
+    if (m_palette_png)
+    {
+        auto result =
+            m_palette_png->Decode(flash, src, size, tile.palette, PaletteRowIndexed, &tile);
+        if (result != PalettePngDecoder::Result::kUnsupported)
+        {
+            return result == PalettePngDecoder::Result::kDecoded;
+        }
+    }
+
+    FlashStream stream {flash, src, static_cast<int32_t>(size)};
+    if (OpenFromFlash(*m_png, stream, PngDrawIndexed) != PNG_SUCCESS)
+    {
+        return false;
+    }
+
+    return DecodePng(tile);
+}
+
+bool
+TileDecoder::DecodeScaledFromFlash(TileCodec codec,
+                                   hal::IFlash& flash,
+                                   const uint8_t* src,
+                                   size_t size,
+                                   unsigned factor,
+                                   std::span<uint16_t> dst,
+                                   const TileStyle& style)
+{
+    if (factor == 0 || kTileSize % factor != 0 ||
+        dst.size() < (kTileSize / factor) * (kTileSize / factor))
+    {
+        return false;
+    }
+
+    DecodeHelperScaled helper {*m_png,
+                               factor,
+                               dst,
+                               style,
+                               m_scaled_palette,
+                               m_styled_palette,
+                               m_index_row.data(),
+                               m_line_buffer.data()};
+
+    if (codec == TileCodec::kPaletteRle)
+    {
+        auto staging = GetStagingBuffer(size);
+        flash.Read(src, staging);
+
+        // The runs continue over the row ends, so collect them to full rows first
+        auto row = m_index_row.data();
+        m_scaled_palette.fill(0);
+        m_styled_palette.reset();
+
+        return ForEachPaletteRleRun(
+            staging,
+            kTileSize * kTileSize,
+            m_scaled_palette,
+            [&helper, row, &style, this](size_t offset, unsigned length, uint8_t index) {
+                if (!m_styled_palette)
+                {
+                    m_styled_palette.emplace(m_scaled_palette, style);
+                }
+
+                while (length > 0)
+                {
+                    const auto x = offset % kTileSize;
+                    const auto n = std::min<size_t>(length, kTileSize - x);
+
+                    std::fill_n(row + x, n, index);
+                    offset += n;
+                    length -= n;
+
+                    if (x + n == kTileSize)
+                    {
+                        helper.ExpandRow(row, offset / kTileSize - 1);
+                    }
+                }
+            });
+    }
+    if (codec != TileCodec::kPng)
+    {
+        return false;
+    }
+
+    if (m_palette_png)
+    {
+        auto result =
+            m_palette_png->Decode(flash, src, size, m_scaled_palette, PaletteRowScaled, &helper);
+        if (result != PalettePngDecoder::Result::kUnsupported)
+        {
+            return result == PalettePngDecoder::Result::kDecoded;
+        }
+    }
+
+    FlashStream stream {flash, src, static_cast<int32_t>(size)};
+    if (OpenFromFlash(*m_png, stream, PngDrawScaled) != PNG_SUCCESS)
+    {
+        return false;
+    }
+
+    if (m_png->getWidth() != kTileSize || m_png->getHeight() != kTileSize)
+    {
+        m_png->close();
+        return false;
+    }
+
+    auto rc = m_png->decode((void*)&helper, 0);
+    m_png->close();
+
+    return rc == PNG_SUCCESS;
+}
+
+bool
+TileDecoder::DecodePng(IndexedTile& tile)
+{
+    if (m_png->getWidth() != kTileSize || m_png->getHeight() != kTileSize)
+    {
+        m_png->close();
+        return false;
+    }
+
+    DecodeHelperIndexed priv(*m_png, tile, m_line_buffer.data());
+    auto rc = m_png->decode((void*)&priv, 0);
+    m_png->close();
+
+    return rc == PNG_SUCCESS;
+}
@@ -1,15 +1,45 @@
 #include "tile_producer.hh"
 
 #include "hal/i_display.hh"
+#include "pixel_kernels.hh"
 
 #include <PNGdec.h>
+#include <cmath>
+#include <limits>
 #include <mutex>
+#include <numbers>
+#include <numeric>
+#include <utility>
 
-constexpr auto kInvalidTileIndex = kTileCacheSize;
+constexpr auto kInvalidTileIndex = std::numeric_limits<uint16_t>::max();
+
+// Tiles decoded per RequestTiles call, compared to the cache size. Leave room for the tiles
+// locked by the UI
+constexpr auto kRequestedTilesReserve = 2;
+
+// Don't prefetch when drifting around
+constexpr auto kPrefetchMinimumSpeed = 1.0f;
+// Look one tile further ahead for every 8 knots, within limits
+constexpr auto kKnotsPerLookaheadTile = 8.0f;
+constexpr auto kMaxLookaheadTiles = 3.0f;
+// Turns smaller than this keep the current prefetch
+constexpr auto kPrefetchHeadingChange = 10.0f;
+
+// The UI holds a tile handle while drawing the tile, so only a few are locked at once
+constexpr auto kTileHandlePoolSize = kMinTileCacheSize;
 
 namespace
 {
 
+class MemoryMappedFlash final : public hal::IFlash
+{
+public:
+    void Read(const uint8_t* src, std::span<uint8_t> dst) final
+    {
+        memcpy(dst.data(), src, dst.size());
+    }
+};
+
 struct ReadHelper
 {
     const std::byte* data;
@@ -48,23 +78,21 @@ struct DecodeHelperMask : DecodeHelper
     std::unique_ptr<uint16_t[]> line_buffer;
 };
 
-struct DecodeHelperGrayscale : DecodeHelper
+TileStyle
+ColorModeToStyle(ColorMode color_mode)
 {
-    DecodeHelperGrayscale(PNG& png, uint16_t* dst, uint16_t land_slant_color)
-        : DecodeHelper(png, dst)
-        , line_buffer(std::make_unique<uint16_t[]>(png.getWidth()))
-        , line_number(0)
-        , land_slant_color(land_slant_color)
+    switch (color_mode)
     {
+    case ColorMode::kBlackWhite:
+        return {.grayscale = true, .hatch_color = 0x0000};
+    case ColorMode::kBlackRed:
+        return {.grayscale = true, .hatch_color = 0xf800};
+    default:
+        break;
     }
 
-    DecodeHelperGrayscale() = delete;
-
-    std::unique_ptr<uint16_t[]> line_buffer;
-    uint16_t line_number;
-    const uint16_t land_slant_color;
-};
-
+    return {};
+}
 
 int
 PngDraw(PNGDRAW* pDraw)
@@ -87,135 +115,283 @@ PngDrawMask(PNGDRAW* pDraw)
         pDraw, helper->line_buffer.get(), PNG_RGB565_LITTLE_ENDIAN, 0xffffffff);
     auto dst = reinterpret_cast<uint8_t*>(helper->dst);
 
-    for (auto i = 0; i < pDraw->iWidth; i++)
-    {
-        auto pixel = helper->line_buffer[i];
-        auto alpha_value = pixel == helper->mask_color ? LV_OPA_TRANSP : LV_OPA_COVER;
-
-        auto b = pixel >> 11;
-        auto g = (pixel >> 5) & 0x3f;
-        auto r = pixel & 0x1f;
-
-        // RGB565 -> ARGB888
-        dst[helper->offset++] = (r * 255) / 31;
-        dst[helper->offset++] = (g * 255) / 63;
-        dst[helper->offset++] = (b * 255) / 31;
-        dst[helper->offset++] = alpha_value;
-    }
+    // RGB565 -> ARGB888
+    Rgb565ToArgb8888Row({helper->line_buffer.get(), static_cast<size_t>(pDraw->iWidth)},
+                        dst + helper->offset,
+                        helper->mask_color);
+    helper->offset += pDraw->iWidth * 4;
 
     return 1;
 }
 
-int
-PngDrawGrayscale(PNGDRAW* pDraw)
+// The largest tile which needs the staging buffer, i.e., not PNG:s when decoding from flash
+template <typename ZoomLevels>
+size_t
+MaxTileSize(const ZoomLevels& levels, bool direct_flash_decode)
 {
-    auto helper = static_cast<DecodeHelperGrayscale*>(pDraw->pUser);
-
-    helper->png.getLineAsRGB565(
-        pDraw, helper->line_buffer.get(), PNG_RGB565_LITTLE_ENDIAN, 0xffffffff);
+    size_t out = 0;
 
+    for (const auto& level : levels)
+    {
+        for (const auto& tile : std::span<const FlashTile>(level.tiles, level.count))
+        {
+            if (direct_flash_decode && static_cast<TileCodec>(tile.codec) == TileCodec::kPng)
+            {
+                continue;
+            }
+            out = std::max(out, static_cast<size_t>(tile.size));
+        }
+    }
 
-    // r: 254, g: 242, b: 203 in rgb565 (after pillow + png conversion). TODO: Don't hardcode
-    const uint16_t kLandColor = 0xff99;
+    return out;
+}
 
-    const auto y = helper->line_number;
-    for (auto x = 0; x < pDraw->iWidth; x++)
+// Storage for Count objects of Size bytes, to avoid allocating short lived objects
+template <size_t Size, size_t Alignment, size_t Count>
+class FixedPool
+{
+public:
+    // nullptr if all are used
+    void* Allocate()
     {
-        const auto pixel = helper->line_buffer[x];
+        std::scoped_lock lock(m_mutex);
 
-        // https://stackoverflow.com/a/71086522, rgb565 to grayscale
-        auto r = (pixel >> 10) & 0x3E; // 6-bit Red Component
-        auto g = (pixel >> 5) & 0x3F;  // 6-bit Green Component
-        auto b = (pixel << 1) & 0x3E;  // 6-bit Blue Component
-
-        auto luma = (r * 218) + (g * 732) + (b * 74); // Wx*1024/10000.
-        luma = (luma >> 10) + ((luma >> 9) & 1);      // 6-bit Luminance value.
+        auto it = std::ranges::find(m_used, false);
+        if (it == m_used.end())
+        {
+            return nullptr;
+        }
+        *it = true;
 
-        auto color = ((luma & 0x3E) << 10) | (luma << 5) | (luma >> 1);
+        return m_storage[std::distance(m_used.begin(), it)];
+    }
 
-        // Right-slant the land color
-        if (pixel == kLandColor && (x + y) % 6 < 2)
+    // false if @a p is not from the pool
+    bool Release(void* p)
+    {
+        const auto first = &m_storage[0][0];
+        auto slot = static_cast<std::byte*>(p);
+        if (slot < first || slot >= first + Count * Size)
         {
-            color = helper->land_slant_color;
+            return false;
         }
 
-        helper->dst[helper->offset++] = color;
+        std::scoped_lock lock(m_mutex);
+        m_used[(slot - first) / Size] = false;
+
+        return true;
     }
 
-    helper->line_number++;
+private:
+    etl::mutex m_mutex;
+    std::array<bool, Count> m_used {};
+    alignas(Alignment) std::byte m_storage[Count][Size];
+};
 
-    return 1;
-}
+} // namespace
 
-class TileHandle final : public ITileHandle
+class TileProducer::TileHandle final : public ITileHandle
 {
+private:
+    static auto& Pool()
+    {
+        static FixedPool<sizeof(TileHandle), alignof(TileHandle), kTileHandlePoolSize> pool;
+
+        return pool;
+    }
+
 public:
-    explicit TileHandle(ImageImpl& image,
-                        uint8_t cache_index,
-                        std::atomic<uint32_t>& locked_cache_entries)
-        : m_image(image)
+    // From the pool, so that locking a tile doesn't allocate. Allocated if it's exhausted
+    static void* operator new(size_t size)
+    {
+        auto p = Pool().Allocate();
+
+        return p ? p : ::operator new(size);
+    }
+
+    static void operator delete(void* p)
+    {
+        if (!Pool().Release(p))
+        {
+            ::operator delete(p);
+        }
+    }
+
+    // Called with m_mutex held
+    explicit TileHandle(const IndexedTile& tile, uint16_t cache_index, TileProducer& parent)
+        : m_tile(tile)
         , m_cache_index(cache_index)
-        , m_locked_cache_entries(locked_cache_entries)
+        , m_style(ColorModeToStyle(parent.m_color_mode))
+        , m_parent(parent)
     {
-        m_locked_cache_entries |= (1 << m_cache_index);
     }
 
     ~TileHandle() final
     {
-        // Unlock the cache entry
-        m_locked_cache_entries &= ~(1 << m_cache_index);
+        std::scoped_lock lock(m_parent.m_mutex);
+
+        m_parent.UnlockCacheEntry(m_cache_index);
+    }
+
+    void Blit(uint16_t* frame_buffer, const Point& at) const final
+    {
+        m_tile.Blit(frame_buffer, at, m_style);
     }
 
-    const Image& GetImage() const final
+    void
+    ZoomedBlit(uint16_t* frame_buffer, unsigned width, unsigned factor, const Point& at) const final
     {
-        return m_image;
+        m_tile.ZoomedBlit(frame_buffer, width, factor, at, m_style);
     }
 
 private:
-    ImageImpl& m_image;
-    const uint8_t m_cache_index;
-    std::atomic<uint32_t>& m_locked_cache_entries;
+    const IndexedTile& m_tile;
+    const uint16_t m_cache_index;
+    const TileStyle m_style;
+    TileProducer& m_parent;
 };
 
-} // namespace
+class TileProducer::DecodeWorker : public os::BaseThread
+{
+public:
+    explicit DecodeWorker(TileProducer& parent)
+        : m_parent(parent)
+        , m_decoder(parent.m_max_tile_size)
+    {
+    }
+
+private:
+    std::optional<milliseconds> OnActivation() final
+    {
+        m_parent.DecodeRequestedTiles(m_decoder);
+
+        return std::nullopt;
+    }
+
+    TileProducer& m_parent;
+    TileDecoder m_decoder;
+};
 
 
-TileProducer::TileProducer(ApplicationState& application_state, const MapMetadata& map_metadata)
+TileProducer::TileProducer(ApplicationState& application_state,
+                           const MapMetadata& map_metadata,
+                           const TileProducerConfig& config)
     : m_flash_start(reinterpret_cast<const uint8_t*>(&map_metadata))
-    , m_flash_tile_data(
-          reinterpret_cast<const FlashTile*>(m_flash_start + map_metadata.tile_data_offset))
     , m_tile_count(map_metadata.tile_count)
     , m_tile_row_size(map_metadata.tile_row_size)
     , m_tile_rows(map_metadata.tile_rows)
+    , m_zoom_levels(GetZoomLevels(map_metadata))
+    , m_all_tile_count(m_zoom_levels.back().first_index + m_zoom_levels.back().count)
+    , m_cache_size(config.cache_size)
+    , m_mapped_flash(config.flash ? nullptr : std::make_unique<MemoryMappedFlash>())
+    , m_flash(config.flash ? *config.flash : *m_mapped_flash)
+    , m_compressed_tiles(config.direct_flash_decode ? 0 : config.compressed_cache_size,
+                         m_all_tile_count)
     , m_application_state(application_state)
-    , m_state_listener(application_state.AttachListener<AS::configuration>(GetSemaphore()))
+    , m_state_listener(
+          application_state.AttachListener<AS::configuration, AS::pixel_position, AS::position>(
+              GetSemaphore()))
+    , m_direct_flash_decode(config.direct_flash_decode)
+    , m_max_tile_size(MaxTileSize(m_zoom_levels, m_direct_flash_decode))
+    , m_decoder(m_max_tile_size)
+    , m_tiles(config.cache_size)
+    , m_lru(config.cache_size)
+    , m_lock_count(config.cache_size)
     , m_state_cache(application_state)
 {
     // Including the default land/empty tile
     assert(m_tile_count == m_tile_row_size * m_tile_rows + 1);
+    assert(config.cache_size >= kMinTileCacheSize && config.cache_size < kInvalidTileIndex);
 
-    m_tile_index_to_cache.resize(m_tile_count);
+    m_tile_index_to_cache.resize(m_all_tile_count);
+    m_pending_tiles.resize(m_all_tile_count);
 
     std::ranges::fill(m_tile_index_to_cache, kInvalidTileIndex);
+    IndexSharedPayloads();
+
+    for (auto i = 0u; i < m_cache_size; i++)
+    {
+        m_lru.PushMostRecent(i);
+    }
+
+    for (auto i = 1u; i < config.decoder_threads; i++)
+    {
+        m_workers.push_back(std::make_unique<DecodeWorker>(*this));
+    }
+}
+
+TileProducer::~TileProducer()
+{
+}
+
+TileProducer::ZoomLevels
+TileProducer::GetZoomLevels(const MapMetadata& metadata)
+{
+    const auto start = reinterpret_cast<const uint8_t*>(&metadata);
+    ZoomLevels out;
+
+    // Not tile_count, the land tile has no entry in the table
+    out[0] = {1,
+              reinterpret_cast<const FlashTile*>(start + metadata.tile_data_offset),
+              0,
+              metadata.tile_row_size * metadata.tile_rows,
+              metadata.tile_row_size};
+
+    for (auto level = 0; level < kZoomedTileLevels; level++)
+    {
+        const auto zoom = 2u << level;
+        const auto& previous = out[level];
+        auto& cur = out[level + 1];
+
+        cur = {zoom, nullptr, previous.first_index + previous.count, 0, 0};
+        if (metadata.HasZoomedTiles(level))
+        {
+            // Rounded up, the last row and column are padded
+            cur.tiles = reinterpret_cast<const FlashTile*>(start +
+                                                           metadata.zoomed_tile_data_offset[level]);
+            cur.row_size = (metadata.tile_row_size + zoom - 1) / zoom;
+            cur.count = cur.row_size * ((metadata.tile_rows + zoom - 1) / zoom);
+        }
+    }
+
+    return out;
+}
+
+bool
+TileProducer::HasZoomedTiles(unsigned zoom) const
+{
+    return zoom > 1 && GetZoomLevel(zoom) != nullptr;
 }
 
 
 // Context: Another thread
 std::unique_ptr<ITileHandle>
-TileProducer::LockTile(const Point& point)
+TileProducer::LockTile(const Point& point, unsigned zoom, TilePriority priority)
 {
-    auto index = PointToTileIndex(point);
+    auto index = PointToTileIndex(point, zoom);
     if (index)
     {
         m_mutex.lock();
 
+        const auto before = std::chrono::steady_clock::now();
+        if (m_tile_index_to_cache[*index] == kInvalidTileIndex)
+        {
+            CountCacheMiss(*index);
+        }
+
         while (m_tile_index_to_cache[*index] == kInvalidTileIndex)
         {
-            m_tile_requests.push(*index);
+            if (!PushTileRequest(priority,
+                                 {*index, &m_tile_request_semaphore, false, nullptr, before}))
+            {
+                // Full (also of cancelled requests not yet popped), so nothing would release us
+                m_mutex.unlock();
+                return nullptr;
+            }
 
             // Release the lock while waiting for the producer thread
             m_mutex.unlock();
-            Awake();
+            WakeDecoders();
             m_tile_request_semaphore.acquire();
 
             m_mutex.lock();
@@ -226,19 +402,148 @@ TileProducer::LockTile(const Point& point)
             }
         }
 
-        auto cache_index = m_tile_index_to_cache[*index];
-        auto out = std::make_unique<TileHandle>(
-            *m_tiles[cache_index], cache_index, m_locked_cache_entries);
+        auto out = LockCacheEntry(m_tile_index_to_cache[*index]);
         m_mutex.unlock();
 
-        return std::move(out);
+        return out;
     }
 
     return nullptr;
 }
 
+std::unique_ptr<ITileHandle>
+TileProducer::TryLockTile(const Point& point,
+                          os::binary_semaphore& ready,
+                          unsigned zoom,
+                          TilePriority priority)
+{
+    auto index = PointToTileIndex(point, zoom);
+    if (!index)
+    {
+        return nullptr;
+    }
+
+    std::scoped_lock lock(m_mutex);
+
+    if (m_tile_index_to_cache[*index] != kInvalidTileIndex)
+    {
+        return LockCacheEntry(m_tile_index_to_cache[*index]);
+    }
+
+    // Request it, unless already done
+    if (!m_pending_tiles[*index] &&
+        PushTileRequest(priority,
+                        {*index, &ready, false, nullptr, std::chrono::steady_clock::now()}))
+    {
+        m_pending_tiles[*index] = true;
+        CountCacheMiss(*index);
+        WakeDecoders();
+    }
+
+    return nullptr;
+}
+
+unsigned
+TileProducer::RequestTiles(std::span<const Point> points,
+                           const Point& center,
+                           os::binary_semaphore& ready,
+                           unsigned zoom,
+                           TilePriority priority)
+{
+    std::scoped_lock lock(m_mutex);
+
+    // Superseded by this set. The tiles can be requested again right away, but the requesters
+    // are released when the decoders pop them
+    m_tile_requests.Cancel(priority, [this](const auto& cancelled) {
+        if (!cancelled.prefetch && !cancelled.scaled)
+        {
+            m_pending_tiles[cancelled.index] = false;
+        }
+    });
+
+    // Drop the old set
+    for (const auto& requested : m_requested_tiles)
+    {
+        m_pending_tiles[requested.index] = false;
+    }
+    m_requested_tiles.clear();
+
+    const auto tile_size = static_cast<int>(kTileSize * zoom);
+    unsigned pending = 0;
+    for (const auto& point : points)
+    {
+        auto index = PointToTileIndex(point, zoom);
+        if (!index || m_tile_index_to_cache[*index] != kInvalidTileIndex)
+        {
+            continue;
+        }
+
+        pending++;
+        if (m_pending_tiles[*index] || m_requested_tiles.full())
+        {
+            // Already requested via TryLockTile/LockTile
+            continue;
+        }
+
+        auto dx = point.x - point.x % tile_size + tile_size / 2 - center.x;
+        auto dy = point.y - point.y % tile_size + tile_size / 2 - center.y;
+
+        m_pending_tiles[*index] = true;
+        m_requested_tiles.push_back(
+            {*index, static_cast<uint32_t>(std::abs(dx) + std::abs(dy))});
+    }
+
+    if (m_requested_tiles.empty())
+    {
+        return pending;
+    }
+
+    std::ranges::sort(m_requested_tiles,
+                      [](const auto& a, const auto& b) { return a.distance > b.distance; });
+    m_requested_tiles_budget = m_cache_size - kRequestedTilesReserve;
+    m_requested_tiles_ready = &ready;
+    m_requested_tiles_time = std::chrono::steady_clock::now();
+
+    WakeDecoders();
+
+    return pending;
+}
+
+std::unique_ptr<ITileHandle>
+TileProducer::LockCacheEntry(uint16_t cache_index)
+{
+    auto& tile = m_tiles[cache_index];
+
+    if (tile.prefetched)
+    {
+        // First use of a prefetched tile
+        tile.prefetched = false;
+        m_stats.prefetch_hits++;
+    }
+    m_stats.cache_hits++;
+
+    if (m_lock_count[cache_index]++ == 0)
+    {
+        // Can't be evicted while locked
+        m_lru.Unlink(cache_index);
+    }
+
+    return std::make_unique<TileHandle>(tile, cache_index, *this);
+}
+
+void
+TileProducer::UnlockCacheEntry(uint16_t cache_index)
+{
+    if (--m_lock_count[cache_index] == 0)
+    {
+        // Just used
+        m_lru.PushMostRecent(cache_index);
+    }
+}
+
+// Context: Another thread
 bool
-TileProducer::IsCached(const Point& point) const
+TileProducer::DecodeTileTo(const Point& point, unsigned factor, std::span<uint16_t> dst)
 {
     auto index = PointToTileIndex(point);
     if (!index)
@@ -246,187 +551,553 @@ TileProducer::IsCached(const Point& point) const
         return false;
     }
 
+    os::binary_semaphore done {0};
+    ScaledTileRequest request {factor, dst, {}, false};
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        request.style = ColorModeToStyle(m_color_mode);
+        if (!PushTileRequest(TilePriority::kThumbnail, {*index, &done, false, &request}))
+        {
+            return false;
+        }
+    }
+
+    // Released when decoded, or if cancelled
+    WakeDecoders();
+    done.acquire();
+
+    return request.decoded;
+}
+
+bool
+TileProducer::IsCached(const Point& point, unsigned zoom) const
+{
+    auto index = PointToTileIndex(point, zoom);
+    if (!index)
+    {
+        return false;
+    }
+
     std::scoped_lock lock(m_mutex);
     return m_tile_index_to_cache[*index] != kInvalidTileIndex;
 }
 
+// Called with m_mutex held
+void
+TileProducer::CountCacheMiss(uint32_t index)
+{
+    if (std::ranges::find(m_prefetch_tiles, index) != m_prefetch_tiles.end())
+    {
+        // Ahead of the boat, but not decoded in time
+        m_stats.prefetch_misses++;
+    }
+    m_stats.cache_misses++;
+}
+
+// Called with m_mutex held
+void
+TileProducer::RecordLockWait(const TileRequest& request)
+{
+    if (request.requested != std::chrono::steady_clock::time_point {})
+    {
+        m_stats.lock_wait_time.Record(std::chrono::steady_clock::now() - request.requested);
+    }
+}
+
+TileProducer::Stats
+TileProducer::GetStats() const
+{
+    auto compressed = m_compressed_tiles.GetStats();
+
+    std::scoped_lock lock(m_mutex);
+    auto out = m_stats;
+    if (!m_direct_flash_decode)
+    {
+        out.compressed = compressed;
+    }
+    out.queue_depth = m_tile_requests.Size();
+
+    return out;
+}
+
 void
 TileProducer::OnStartup()
 {
     m_color_mode = m_application_state.CheckoutReadonly().Get<AS::configuration>()->color_mode;
+
+    for (auto& worker : m_workers)
+    {
+        worker->Start("tile_decoder", os::ThreadCore::kCore1, os::ThreadPriority::kHigh, 8192);
+    }
 }
 
 std::optional<milliseconds>
 TileProducer::OnActivation()
 {
     auto& co = m_state_cache.Pull();
-    uint32_t requested_index = 0;
 
     co.OnChangedValue<AS::configuration>([this](auto& old_conf, auto& new_conf) {
         if (new_conf.color_mode != old_conf.color_mode)
         {
-            m_color_mode = new_conf.color_mode;
-
-            // Drop all cached data
+            // The cached tiles are kept, the color mode is applied when they are drawn
             std::scoped_lock lock(m_mutex);
-            m_tiles.clear();
-            m_tile_request_order.clear();
-            m_tile_index_to_cache.clear();
-            m_tile_index_to_cache.resize(m_tile_count);
-            std::ranges::fill(m_tile_index_to_cache, kInvalidTileIndex);
+            m_color_mode = new_conf.color_mode;
         }
     });
 
-    while (m_tile_requests.pop(requested_index))
+    auto ro = m_application_state.CheckoutReadonly();
+    auto position = ro.Get<AS::position>();
+
     {
-        CacheTile(requested_index);
-        m_tile_request_semaphore.release();
+        // EvictTile() reads the position with the lock held
+        std::scoped_lock lock(m_mutex);
+
+        m_position = *ro.Get<AS::pixel_position>();
+        m_heading = position->heading;
+        m_speed = position->speed;
     }
 
+    // Queue the tiles the boat is heading into, decoded when idle
+    PrefetchTiles();
+
+    DecodeRequestedTiles(m_decoder);
+
     return std::nullopt;
 }
 
+void
+TileProducer::WakeDecoders()
+{
+    Awake();
+    for (auto& worker : m_workers)
+    {
+        worker->Awake();
+    }
+}
+
 bool
-TileProducer::CacheTile(unsigned requested_index)
+TileProducer::PushTileRequest(TilePriority priority, const TileRequest& request)
 {
-    auto tile = DecodeTile(requested_index);
-    if (!tile)
+    if (!m_tile_requests.Push(priority, request))
     {
         return false;
     }
 
-    std::scoped_lock lock(m_mutex);
-    auto cache_index = m_tiles.size();
+    m_stats.max_queue_depth =
+        std::max(m_stats.max_queue_depth, static_cast<unsigned>(m_tile_requests.Size()));
+
+    return true;
+}
+
+std::optional<TileProducer::TileRequest>
+TileProducer::PopTileRequest(TilePriority lowest)
+{
+    // The pending bits were cleared when cancelled, let the requester ask again if still needed
+    return m_tile_requests.Pop(lowest, [](const auto& cancelled) {
+        if (cancelled.ready)
+        {
+            cancelled.ready->release();
+        }
+    });
+}
 
-    if (m_tiles.full())
+void
+TileProducer::DecodeRequestedTiles(TileDecoder& decoder)
+{
+    while (true)
     {
-        cache_index = EvictTile();
-        assert(m_tiles[cache_index] == nullptr);
-        m_tiles[cache_index] = std::move(tile);
+        std::optional<TileRequest> request;
+        auto from_set = false;
+
+        {
+            std::scoped_lock lock(m_mutex);
+
+            // Single tile requests first, then the requested set, closest first, and the tiles
+            // ahead of the boat when there's nothing else to do
+            request = PopTileRequest(TilePriority::kThumbnail);
+            if (!request)
+            {
+                if (auto index = PopRequestedTile(); index)
+                {
+                    request =
+                        TileRequest {*index, nullptr, false, nullptr, m_requested_tiles_time};
+                    from_set = true;
+                }
+                else if (m_requested_tiles.empty())
+                {
+                    request = PopTileRequest(TilePriority::kPrefetch);
+                }
+            }
+
+            if (!request)
+            {
+                return;
+            }
+        }
+
+        if (request->scaled)
+        {
+            request->scaled->decoded = DecodeScaledTile(decoder, request->index, *request->scaled);
+        }
+        else
+        {
+            CacheTile(decoder, *request);
+        }
+
+        if (from_set)
+        {
+            std::scoped_lock lock(m_mutex);
+
+            m_requested_tiles_in_flight--;
+            CompleteRequestedTiles();
+        }
+        else if (request->ready)
+        {
+            request->ready->release();
+        }
     }
-    else
+}
+
+std::optional<uint32_t>
+TileProducer::PopRequestedTile()
+{
+    if (m_requested_tiles.empty() || m_requested_tiles_budget == 0)
     {
-        m_tiles.push_back(std::move(tile));
+        CompleteRequestedTiles();
+
+        return std::nullopt;
     }
-    m_tile_request_order.push_back(requested_index);
 
-    m_tile_index_to_cache[requested_index] = cache_index;
+    auto index = m_requested_tiles.back().index;
+    m_requested_tiles.pop_back();
+    m_requested_tiles_budget--;
+    m_requested_tiles_in_flight++;
 
-    return true;
+    return index;
 }
 
-uint8_t
-TileProducer::EvictTile()
+void
+TileProducer::CompleteRequestedTiles()
 {
-    if (m_tile_request_order.empty())
+    if (m_requested_tiles_in_flight != 0 ||
+        (!m_requested_tiles.empty() && m_requested_tiles_budget != 0))
     {
-        assert(false);
-        return 0;
+        // Other decoders are still busy with this batch
+        return;
     }
 
-    while (true)
+    // Done with this batch, let the requester pick up the tiles
+    if (m_requested_tiles_ready)
+    {
+        m_requested_tiles_ready->release();
+        m_requested_tiles_ready = nullptr;
+    }
+}
+
+void
+TileProducer::PrefetchTiles()
+{
+    if (m_speed < kPrefetchMinimumSpeed)
+    {
+        m_prefetch_origin = std::nullopt;
+        return;
+    }
+
+    // The queued prefetch stays valid until the boat enters another tile, or turns
+    const auto origin = PointToTileIndex(m_position);
+    if (origin && origin == m_prefetch_origin &&
+        std::abs(std::remainder(m_heading - m_prefetch_heading, 360.0f)) < kPrefetchHeadingChange)
+    {
+        return;
+    }
+    m_prefetch_origin = origin;
+    m_prefetch_heading = m_heading;
+
+    // The heading is in degrees, clockwise from north
+    const auto heading = m_heading * std::numbers::pi_v<float> / 180.0f;
+    const auto dx = std::sin(heading);
+    const auto dy = -std::cos(heading);
+    const auto lookahead =
+        kTileSize * std::clamp(m_speed / kKnotsPerLookaheadTile, 1.0f, kMaxLookaheadTiles);
+
+    const auto visible = VisibleTiles(m_position);
+    etl::vector<uint32_t, kTilePrefetchCount> to_prefetch;
+
+    // Walk along the projected track, nearest tiles first
+    for (auto distance = kTileSize / 2.0f; distance <= lookahead && !to_prefetch.full();
+         distance += kTileSize / 2.0f)
     {
-        auto index = m_tile_request_order.front();
-        m_tile_request_order.pop_front();
+        auto ahead = Point {m_position.x + static_cast<int32_t>(dx * distance),
+                            m_position.y + static_cast<int32_t>(dy * distance)};
 
-        for (auto i = 0; i < m_tiles.size(); i++)
+        for (auto index : VisibleTiles(ahead))
         {
-            auto& tile = m_tiles[i];
-            if (!tile)
+            if (to_prefetch.full())
             {
-                // Shouldn't be possible, but anyway
-                continue;
+                break;
             }
-            if (tile->index == index)
+            if (std::ranges::find(visible, index) != visible.end() ||
+                std::ranges::find(to_prefetch, index) != to_prefetch.end())
             {
-                if (m_locked_cache_entries & (1 << i))
-                {
-                    m_tile_request_order.push_back(index);
-                    break;
-                }
-
-                m_tile_index_to_cache[tile->index] = kInvalidTileIndex;
-                m_tiles[i] = nullptr;
-
-                return i;
+                continue;
             }
+
+            to_prefetch.push_back(index);
         }
     }
 
-    assert(false);
+    // Replaces the previous prefetch, the decoders take them after the requested tiles
+    std::scoped_lock lock(m_mutex);
 
-    return 0;
+    m_tile_requests.Cancel(TilePriority::kPrefetch);
+    m_prefetch_tiles = to_prefetch;
+    for (auto index : to_prefetch)
+    {
+        if (m_tile_index_to_cache[index] == kInvalidTileIndex)
+        {
+            PushTileRequest(TilePriority::kPrefetch, {index, nullptr, true});
+        }
+    }
 }
 
-std::unique_ptr<ImageImpl>
-TileProducer::DecodeTile(unsigned index)
+etl::vector<uint32_t, kVisibleTileCount>
+TileProducer::VisibleTiles(const Point& position) const
 {
-    if (index >= m_tile_count)
+    etl::vector<uint32_t, kVisibleTileCount> out;
+
+    // Same as the map screen, the display is centered around the position
+    const auto max_x =
+        std::max(0, static_cast<int>(m_tile_row_size * kTileSize) - hal::kDisplayWidth);
+    const auto max_y = std::max(0, static_cast<int>(m_tile_rows * kTileSize) - hal::kDisplayHeight);
+    const auto left = std::clamp(static_cast<int>(position.x - hal::kDisplayWidth / 2), 0, max_x);
+    const auto top = std::clamp(static_cast<int>(position.y - hal::kDisplayHeight / 2), 0, max_y);
+
+    for (auto y = top / kTileSize; y <= (top + hal::kDisplayHeight - 1) / kTileSize; y++)
     {
-        return nullptr;
+        for (auto x = left / kTileSize; x <= (left + hal::kDisplayWidth - 1) / kTileSize; x++)
+        {
+            if (auto index = PointToTileIndex({x * kTileSize, y * kTileSize}); index)
+            {
+                out.push_back(*index);
+            }
+        }
     }
 
-    auto png = std::make_unique<PNG>();
+    return out;
+}
+
+bool
+TileProducer::CacheTile(TileDecoder& decoder, const TileRequest& request)
+{
+    const auto requested_index = request.index;
+    const auto prefetch = request.prefetch;
+    uint16_t cache_index;
+
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_tile_index_to_cache[requested_index] != kInvalidTileIndex)
+        {
+            // Already cached (requested twice, or prefetched)
+            m_pending_tiles[requested_index] = false;
+            RecordLockWait(request);
+            return true;
+        }
+
+        // Never throw out what's on screen for something which might be needed later
+        auto evicted = EvictTile(prefetch);
+        if (!evicted)
+        {
+            // Everything is locked
+            m_pending_tiles[requested_index] = false;
+            return false;
+        }
 
-    const auto& tile = m_flash_tile_data[index];
-    const auto flash_data = m_flash_start + tile.flash_offset;
-    const auto tile_size = tile.size;
+        // Decode straight into the entry, which is unlinked meanwhile
+        cache_index = *evicted;
+        m_lru.Unlink(cache_index);
+    }
 
-    auto in_psram = std::make_unique<uint8_t[]>(tile_size);
-    memcpy(in_psram.get(), flash_data, tile_size);
+    auto& tile = m_tiles[cache_index];
+    const auto before = std::chrono::steady_clock::now();
+    auto decoded = DecodeTile(decoder, requested_index, tile);
+    const auto decode_time = std::chrono::steady_clock::now() - before;
 
-    int rc;
+    std::scoped_lock lock(m_mutex);
+    m_pending_tiles[requested_index] = false;
+    m_stats.decode_time.Record(decode_time);
+    RecordLockWait(request);
 
-    if (m_color_mode == ColorMode::kColor)
+    if (!decoded || m_tile_index_to_cache[requested_index] != kInvalidTileIndex)
     {
-        rc = png->openFLASH(in_psram.get(), tile_size, PngDraw);
+        // Corrupt, or decoded by another worker in the meantime
+        m_lru.PushLeastRecent(cache_index);
+        return decoded;
     }
-    else
+
+    if (prefetch)
     {
-        rc = png->openFLASH(in_psram.get(), tile_size, PngDrawGrayscale);
+        m_stats.prefetched++;
     }
 
-    if (rc != PNG_SUCCESS)
+    tile.index = requested_index;
+    tile.prefetched = prefetch;
+    m_tile_index_to_cache[requested_index] = cache_index;
+    m_lru.PushMostRecent(cache_index);
+
+    return true;
+}
+
+std::optional<uint16_t>
+TileProducer::EvictTile(bool keep_visible)
+{
+    const auto visible =
+        keep_visible ? VisibleTiles(m_position) : etl::vector<uint32_t, kVisibleTileCount> {};
+
+    // Locked entries are not in the list, so at most the visible tiles are skipped
+    for (auto cache_index = m_lru.LeastRecent(); cache_index;
+         cache_index = m_lru.MoreRecent(*cache_index))
     {
-        return nullptr;
+        auto& tile = m_tiles[*cache_index];
+
+        if (tile.index == IndexedTile::kNoTile)
+        {
+            // Unused entry
+            return *cache_index;
+        }
+        if (std::ranges::find(visible, tile.index) != visible.end())
+        {
+            continue;
+        }
+
+        if (tile.prefetched)
+        {
+            m_stats.prefetch_unused++;
+        }
+        m_stats.evictions++;
+
+        m_tile_index_to_cache[tile.index] = kInvalidTileIndex;
+        tile.index = IndexedTile::kNoTile;
+
+        return *cache_index;
     }
-    auto img = std::make_unique<ImageImpl>(index);
 
-    if (m_color_mode == ColorMode::kColor)
+    return std::nullopt;
+}
+
+bool
+TileProducer::DecodeTile(TileDecoder& decoder, unsigned index, IndexedTile& tile)
+{
+    if (index >= m_all_tile_count)
     {
-        DecodeHelper priv(*png, reinterpret_cast<uint16_t*>(img->rgb565_data.data()));
-        rc = png->decode((void*)&priv, 0);
+        return false;
     }
-    else
+
+    const auto& flash_tile = GetFlashTile(index);
+    const auto codec = static_cast<TileCodec>(flash_tile.codec);
+
+    if (m_direct_flash_decode)
     {
-        DecodeHelperGrayscale priv(*png,
-                                   reinterpret_cast<uint16_t*>(img->rgb565_data.data()),
-                                   m_color_mode == ColorMode::kBlackRed ? 0xf800 : 0x0000);
+        {
+            // Not through the compressed tile cache, so counted here
+            std::scoped_lock lock(m_mutex);
+            m_stats.compressed.misses++;
+            m_stats.compressed.flash_bytes += flash_tile.size;
+        }
 
-        rc = png->decode((void*)&priv, 0);
+        return decoder.DecodeFromFlash(
+            codec, m_flash, m_flash_start + flash_tile.flash_offset, flash_tile.size, tile);
     }
 
-    png->close();
-    if (rc != PNG_SUCCESS)
+    // From the compressed tile cache if possible, otherwise from flash
+    auto compressed = decoder.GetStagingBuffer(flash_tile.size);
+    m_compressed_tiles.Read(index, m_flash, m_flash_start + flash_tile.flash_offset, compressed);
+
+    return decoder.Decode(codec, compressed, tile);
+}
+
+bool
+TileProducer::DecodeScaledTile(TileDecoder& decoder,
+                               unsigned index,
+                               const ScaledTileRequest& request)
+{
+    if (index >= m_all_tile_count)
     {
-        //printf("Argh tile %d @%p\n", index, flash_data);
-        return nullptr;
+        return false;
     }
 
-    return img;
-}
+    // Always from flash, to keep the compressed tile cache for the map as well
+    const auto& flash_tile = GetFlashTile(index);
 
+    return decoder.DecodeScaledFromFlash(static_cast<TileCodec>(flash_tile.codec),
+                                         m_flash,
+                                         m_flash_start + flash_tile.flash_offset,
+                                         flash_tile.size,
+                                         request.factor,
+                                         request.dst,
+                                         request.style);
+}
 
 std::optional<unsigned>
-TileProducer::PointToTileIndex(const Point& point) const
+TileProducer::PointToTileIndex(const Point& point, unsigned zoom) const
 {
-    auto index = (point.y / kTileSize) * m_tile_row_size + point.x / kTileSize;
-    if (index >= m_tile_count)
+    auto level = GetZoomLevel(zoom);
+    if (!level)
     {
         return std::nullopt;
     }
 
-    return index;
+    const auto tile_size = static_cast<int>(kTileSize * zoom);
+    auto index = (point.y / tile_size) * level->row_size + point.x / tile_size;
+    if (index >= level->count)
+    {
+        return std::nullopt;
+    }
+
+    return m_payload_tile_index[level->first_index + index];
+}
+
+void
+TileProducer::IndexSharedPayloads()
+{
+    std::vector<uint32_t> by_offset(m_all_tile_count);
+    std::iota(by_offset.begin(), by_offset.end(), 0);
+    std::ranges::stable_sort(
+        by_offset, {}, [this](auto index) { return GetFlashTile(index).flash_offset; });
+
+    m_payload_tile_index.resize(m_all_tile_count);
+    auto first = by_offset.front();
+    for (auto index : by_offset)
+    {
+        if (GetFlashTile(index).flash_offset != GetFlashTile(first).flash_offset)
+        {
+            first = index;
+        }
+        m_payload_tile_index[index] = first;
+    }
+}
+
+const TileProducer::ZoomLevel*
+TileProducer::GetZoomLevel(unsigned zoom) const
+{
+    auto it = std::ranges::find_if(m_zoom_levels, [zoom](const auto& level) {
+        return level.zoom == zoom && level.tiles != nullptr;
+    });
+
+    return it == m_zoom_levels.end() ? nullptr : &*it;
+}
+
+const FlashTile&
+TileProducer::GetFlashTile(unsigned index) const
+{
+    // The levels are in index order
+    auto level = std::ranges::find_if(m_zoom_levels, [index](const auto& level) {
+        return index < level.first_index + level.count;
+    });
+    assert(level != m_zoom_levels.end());
+
+    return level->tiles[index - level->first_index];
 }
 
 std::unique_ptr<Image>
@@ -94,6 +94,7 @@ private:
     const uint32_t m_tile_row_size;
     const uint32_t m_land_mask_rows;
     const uint32_t m_land_mask_row_size;
+    const std::span<const uint32_t> m_land_mask;
 
     ApplicationState& m_application_state;
     TileProducer& m_tile_producer;
@@ -3,12 +3,15 @@
 #include "boat.hh"
 #include "cohen_sutherland.hh"
 #include "crosshair.hh"
-#include "painter.hh"
 #include "route_utils.hh"
 
 constexpr auto kMaxKnots = 30;
 constexpr auto kSpeedometerMaxAngle = 202;
 
+// Shown until the real tile has been decoded (rgb565)
+constexpr uint16_t kPlaceholderLandColor = 0xff99;
+constexpr uint16_t kPlaceholderWaterColor = 0xae9b;
+
 UserInterface::MapScreen::MapScreen(UserInterface& parent)
     : ScreenBase(parent)
     , m_boat_data(DecodePngMask(boat_data, 0))
@@ -587,18 +590,64 @@ UserInterface::MapScreen::DrawMapTiles(const Point& position)
     auto start_x = position.x - x_remainder;
     auto start_y = position.y - y_remainder;
 
-    // Blit all needed tiles
+    etl::vector<Point, kVisibleTileCount> visible;
+    for (auto y = 0; y < num_tiles_y; y++)
+    {
+        for (auto x = 0; x < num_tiles_x; x++)
+        {
+            visible.push_back({start_x + x * kTileSize, start_y + y * kTileSize});
+        }
+    }
+
+    // Request all missing tiles in one go. Wakes the UI again when they are ready
+    m_parent.m_tile_producer.RequestTiles(visible, m_parent.m_position, m_parent.GetSemaphore());
+
+    // Blit all needed tiles, or a placeholder for the ones which are not yet decoded
     for (auto y = 0; y < num_tiles_y; y++)
     {
         for (auto x = 0; x < num_tiles_x; x++)
         {
-            auto tile = m_parent.m_tile_producer.LockTile(
-                {start_x + x * kTileSize, start_y + y * kTileSize});
+            auto at = Point {start_x + x * kTileSize, start_y + y * kTileSize};
+            auto dst = Point {x * kTileSize - x_remainder, y * kTileSize - y_remainder};
+
+            auto tile = m_parent.m_tile_producer.TryLockTile(at, m_parent.GetSemaphore());
             if (tile)
             {
-                painter::Blit(reinterpret_cast<uint16_t*>(m_static_map_buffer.get()),
-                              tile->GetImage(),
-                              {x * kTileSize - x_remainder, y * kTileSize - y_remainder});
+                tile->Blit(reinterpret_cast<uint16_t*>(m_static_map_buffer.get()), dst);
+            }
+            else
+            {
+                DrawPlaceholderTile(at, dst);
+            }
+        }
+    }
+}
+
+void
+UserInterface::MapScreen::DrawPlaceholderTile(const Point& tile_position, const Point& dst)
+{
+    auto frame_buffer = reinterpret_cast<uint16_t*>(m_static_map_buffer.get());
+
+    // Flat land/water blocks, one per land mask entry
+    for (auto y = 0; y < kTileSize; y += kPathFinderTileSize)
+    {
+        for (auto x = 0; x < kTileSize; x += kPathFinderTileSize)
+        {
+            auto land_index = PointToLandIndex({tile_position.x + x, tile_position.y + y},
+                                               m_parent.m_land_mask_row_size);
+            auto color = IsWater(m_parent.m_land_mask, land_index) ? kPlaceholderWaterColor
+                                                                   : kPlaceholderLandColor;
+
+            auto x_start = std::max(0, dst.x + x);
+            auto x_end = std::min(hal::kDisplayWidth, dst.x + x + kPathFinderTileSize);
+            auto y_start = std::max(0, dst.y + y);
+            auto y_end = std::min(hal::kDisplayHeight, dst.y + y + kPathFinderTileSize);
+
+            for (auto row = y_start; row < y_end && x_start < x_end; row++)
+            {
+                std::fill(frame_buffer + row * hal::kDisplayWidth + x_start,
+                          frame_buffer + row * hal::kDisplayWidth + x_end,
+                          color);
             }
         }
     }
@@ -630,14 +679,18 @@ UserInterface::MapScreen::PrepareInitialZoomedOutMap()
     memset(
         m_static_map_buffer.get(), 0, hal::kDisplayWidth * hal::kDisplayHeight * sizeof(uint16_t));
 
+    // Use the zoomed out tiles from the map if present, otherwise scale down the full size ones
+    m_tile_zoom = m_parent.m_tile_producer.HasZoomedTiles(m_zoom_level) ? m_zoom_level : 1;
+    const auto tile_size = static_cast<int32_t>(kTileSize * m_tile_zoom);
+
     // Align with the nearest tile
-    auto aligned = Point {m_parent.m_position.x - m_parent.m_position.x % kTileSize,
-                          m_parent.m_position.y - m_parent.m_position.y % kTileSize};
+    auto aligned = Point {m_parent.m_position.x - m_parent.m_position.x % tile_size,
+                          m_parent.m_position.y - m_parent.m_position.y % tile_size};
 
     if (m_parent.m_select_position)
     {
-        aligned = Point {m_crosshair_position.x - m_crosshair_position.x % kTileSize,
-                         m_crosshair_position.y - m_crosshair_position.y % kTileSize};
+        aligned = Point {m_crosshair_position.x - m_crosshair_position.x % tile_size,
+                         m_crosshair_position.y - m_crosshair_position.y % tile_size};
     }
 
     const auto offset_x =
@@ -646,69 +699,60 @@ UserInterface::MapScreen::PrepareInitialZoomedOutMap()
         std::max(static_cast<int32_t>(0), aligned.y - (m_zoom_level * hal::kDisplayHeight) / 2);
     m_map_position_zoomed_out = Point {offset_x, offset_y};
 
-    auto num_tiles_x = hal::kDisplayWidth / (kTileSize / m_zoom_level);
-    auto num_tiles_y = hal::kDisplayHeight / (kTileSize / m_zoom_level);
-
-    etl::vector<Point, kTileCacheSize> cached_tiles;
+    auto num_tiles_x = m_zoom_level * hal::kDisplayWidth / tile_size;
+    auto num_tiles_y = m_zoom_level * hal::kDisplayHeight / tile_size;
 
     for (auto y = 0; y < num_tiles_y; y++)
     {
         for (auto x = 0; x < num_tiles_x; x++)
         {
-            auto at = Point {offset_x + x * kTileSize, offset_y + y * kTileSize};
-
-            if (m_parent.m_tile_producer.IsCached(at) && cached_tiles.full() == false)
-            {
-                cached_tiles.push_back(at);
-            }
-            else
-            {
-                m_zoomed_out_map_tiles.push_back(at);
-            }
+            m_zoomed_out_map_tiles.push_back(
+                Point {offset_x + x * tile_size, offset_y + y * tile_size});
         }
     }
 
-    for (const auto& position : cached_tiles)
-    {
-        DrawZoomedTile(position);
-    }
-
-    m_parent.Awake();
+    FillZoomedOutMap();
 }
 
 void
 UserInterface::MapScreen::FillZoomedOutMap()
 {
-    const auto num_tiles_x = hal::kDisplayWidth / (kTileSize / m_zoom_level);
-    for (auto i = 0; i < num_tiles_x; i++)
-    {
-        if (m_zoomed_out_map_tiles.empty())
-        {
-            break;
-        }
-
-        auto position = m_zoomed_out_map_tiles.back();
-        DrawZoomedTile(position);
-        m_zoomed_out_map_tiles.pop_back();
-    }
-
-    m_parent.Awake();
+    auto center = m_parent.m_select_position ? m_crosshair_position : m_parent.m_position;
+
+    // Request the missing tiles in one go, nearest first. Wakes the UI again when they are ready
+    auto pending = m_parent.m_tile_producer.RequestTiles(m_zoomed_out_map_tiles,
+                                                         center,
+                                                         m_parent.GetSemaphore(),
+                                                         m_tile_zoom,
+                                                         TilePriority::kOverview);
+
+    // Draw what's ready, and keep the rest for the next round (outside the map if none is pending)
+    auto drawn = std::remove_if(
+        m_zoomed_out_map_tiles.begin(),
+        m_zoomed_out_map_tiles.end(),
+        [this, pending](const auto& position) { return DrawZoomedTile(position) || pending == 0; });
+    m_zoomed_out_map_tiles.erase(drawn, m_zoomed_out_map_tiles.end());
 }
 
-void
+bool
 UserInterface::MapScreen::DrawZoomedTile(const Point& position)
 {
-    auto tile = m_parent.m_tile_producer.LockTile(position);
-    if (tile)
+    auto tile = m_parent.m_tile_producer.TryLockTile(
+        position, m_parent.GetSemaphore(), m_tile_zoom, TilePriority::kOverview);
+    if (!tile)
     {
-        auto dst = Point {position.x - m_map_position_zoomed_out.x,
-                          position.y - m_map_position_zoomed_out.y};
-        painter::ZoomedBlit(reinterpret_cast<uint16_t*>(m_static_map_buffer.get()),
-                            hal::kDisplayWidth,
-                            tile->GetImage(),
-                            m_zoom_level,
-                            {dst.x / m_zoom_level, dst.y / m_zoom_level});
+        return false;
     }
+
+    auto dst =
+        Point {position.x - m_map_position_zoomed_out.x, position.y - m_map_position_zoomed_out.y};
+    // Native zoomed out tiles are drawn as is
+    tile->ZoomedBlit(reinterpret_cast<uint16_t*>(m_static_map_buffer.get()),
+                     hal::kDisplayWidth,
+                     m_zoom_level / m_tile_zoom,
+                     {dst.x / m_zoom_level, dst.y / m_zoom_level});
+
+    return true;
 }
 
 void
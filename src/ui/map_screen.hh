@@ -55,6 +55,7 @@ private:
 
     Point PositionToMapCenter(const Point& pixel_position) const;
     void DrawMapTiles(const Point& position);
+    void DrawPlaceholderTile(const Point& tile_position, const Point& dst);
 
     void DrawBoat();
     void DrawSpeedometer();
@@ -67,7 +68,7 @@ private:
 
     void PrepareInitialZoomedOutMap();
     void FillZoomedOutMap();
-    void DrawZoomedTile(const Point& position);
+    bool DrawZoomedTile(const Point& position);
 
     void RunStateMachine();
 
@@ -98,10 +99,11 @@ private:
     Point m_map_position_zoomed_out {0, 0};
     State m_state {State::kMap};
     int32_t m_zoom_level {1};
+    // The zoom of the overview tiles, m_zoom_level if the map has zoomed out tiles, otherwise 1
+    int32_t m_tile_zoom {1};
 
     // Enough space for all tiles at zoom level 4, offset
-    etl::vector<Point, (hal::kDisplayWidth / kTileSize) * 4 * (hal::kDisplayHeight / kTileSize) * 4>
-        m_zoomed_out_map_tiles;
+    etl::vector<Point, kMaxRequestedTiles> m_zoomed_out_map_tiles;
 
     std::unique_ptr<uint8_t[]> m_static_map_buffer;
     std::unique_ptr<Image> m_static_map_image;
@@ -1,6 +1,5 @@
 #include "menu_screen.hh"
 
-#include "painter.hh"
 #include "route_utils.hh"
 #include "version.hh"
 
@@ -43,12 +42,14 @@ UserInterface::MenuScreen::MenuScreen(UserInterface& parent, std::function<void(
     lv_obj_t* route_page = lv_menu_page_create(m_menu, NULL);
     lv_obj_t* settings_page = lv_menu_page_create(m_menu, NULL);
     lv_obj_t* color_mode_page = lv_menu_page_create(m_menu, NULL);
+    lv_obj_t* tile_stats_page = lv_menu_page_create(m_menu, NULL);
     lv_obj_t* main_page = lv_menu_page_create(m_menu, NULL);
 
     lv_obj_set_scrollbar_mode(main_page, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_scrollbar_mode(route_page, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_scrollbar_mode(settings_page, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_scrollbar_mode(color_mode_page, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_scrollbar_mode(tile_stats_page, LV_SCROLLBAR_MODE_OFF);
 
 
     // TODO: If a home position is set
@@ -160,6 +161,9 @@ UserInterface::MenuScreen::MenuScreen(UserInterface& parent, std::function<void(
         m_on_close();
     });
 
+    AddEntryToSubPage(settings_page, "Tile statistics", tile_stats_page);
+    AddTileStatistics(tile_stats_page);
+
     AddEntry(settings_page, std::format("OTA update ({})", kSoftwareVersion), [this](auto) {
         auto rw = m_parent.m_application_state.CheckoutReadWrite();
         rw.Set<AS::ota_update_active>(true);
@@ -237,15 +241,15 @@ UserInterface::MenuScreen::AddMapEntry(lv_obj_t* page,
                                        std::function<void(lv_event_t*)> on_click)
 {
     auto obj = AddEntry(page, text, on_click);
-    auto tile = m_parent.m_tile_producer.LockTile(point);
-    if (tile)
+    auto p_16 = reinterpret_cast<uint16_t*>(buffer);
+
+    // Decoded straight into the thumbnail, to leave the tile cache to the map screen
+    if (m_parent.m_tile_producer.DecodeTileTo(
+            point, 3, {p_16, (kTileSize / 3) * (kTileSize / 3)}))
     {
-        auto p_16 = reinterpret_cast<uint16_t*>(buffer);
         auto x_offset = (point.x % kTileSize) / 3;
         auto y_offset = (point.y % kTileSize) / 3;
 
-        painter::ZoomedBlit(p_16, kTileSize / 3, tile->GetImage(), 3, {0, 0});
-
         // Mark as green
         for (auto x = -2; x < 2; x++)
         {
@@ -276,6 +280,39 @@ UserInterface::MenuScreen::AddMapEntry(lv_obj_t* page,
     return obj;
 }
 
+void
+UserInterface::MenuScreen::AddTileStatistics(lv_obj_t* page)
+{
+    auto stats = m_parent.m_tile_producer.GetStats();
+    auto percent = [](auto hits, auto misses) {
+        return hits + misses == 0 ? 0 : 100 * hits / (hits + misses);
+    };
+    auto ms = [](auto us) { return std::format("{:.1f}ms", us.count() / 1000.0f); };
+
+    // Selectable, so the page can be scrolled
+    auto add = [this, page](const std::string& text) { AddEntry(page, text, [](auto) {}); };
+
+    add(std::format("Hits {}% ({}/{})",
+                    percent(stats.cache_hits, stats.cache_misses),
+                    stats.cache_hits,
+                    stats.cache_misses));
+    add(std::format("Prefetch {}%, unused {}",
+                    percent(stats.prefetch_hits, stats.prefetch_misses),
+                    stats.prefetch_unused));
+    add(std::format("Evictions {}", stats.evictions));
+    add(std::format("Decode {} (p90 {})",
+                    ms(stats.decode_time.Average()),
+                    ms(stats.decode_time.Percentile(90))));
+    add(std::format("Blocked {}x, {} (max {})",
+                    stats.lock_wait_time.count,
+                    ms(stats.lock_wait_time.Average()),
+                    ms(stats.lock_wait_time.Max())));
+    add(std::format("Queue {} (max {})", stats.queue_depth, stats.max_queue_depth));
+    add(std::format("Flash {} KiB, saved {} KiB",
+                    stats.compressed.flash_bytes / 1024,
+                    stats.compressed.saved_flash_bytes / 1024));
+}
+
 lv_obj_t*
 UserInterface::MenuScreen::AddEntryToSubPage(lv_obj_t* page, const char* text, lv_obj_t* route_page)
 {
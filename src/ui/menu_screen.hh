@@ -33,6 +33,9 @@ private:
 
     void AddSeparator(lv_obj_t* page);
 
+    // The TileProducer counters, as read when the menu is opened
+    void AddTileStatistics(lv_obj_t* page);
+
     void AddBooleanEntry(lv_obj_t* page,
                          const char* text,
                          bool default_value,
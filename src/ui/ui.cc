@@ -25,6 +25,9 @@ UserInterface::UserInterface(ApplicationState& application_state,
     , m_tile_row_size(metadata.tile_row_size)
     , m_land_mask_rows(metadata.land_mask_rows)
     , m_land_mask_row_size(metadata.land_mask_row_size)
+    , m_land_mask(reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(&metadata) +
+                                                    metadata.land_mask_data_offset),
+                  (metadata.land_mask_rows * metadata.land_mask_row_size) / 32)
     , m_application_state(application_state)
     , m_tile_producer(tile_producer)
     , m_display(display)
@@ -0,0 +1,90 @@
+#include "allocation_counter.hh"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+thread_local unsigned g_allocations = 0;
+
+} // namespace
+
+AllocationCounter::AllocationCounter()
+    : m_start(g_allocations)
+{
+}
+
+unsigned
+AllocationCounter::Count() const
+{
+    return g_allocations - m_start;
+}
+
+void*
+operator new(size_t size)
+{
+    g_allocations++;
+    if (auto p = malloc(size ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void*
+operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void*
+operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    g_allocations++;
+
+    return malloc(size ? size : 1);
+}
+
+void*
+operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void
+operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void
+operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+}
+
+void
+operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @brief Count the allocations made by this thread while in scope
+ *
+ * allocation_counter.cc replaces the global operator new, so it's only linked into
+ * ut_allocations, not the other unit tests.
+ */
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+
+    // The allocations since construction
+    unsigned Count() const;
+
+private:
+    const unsigned m_start;
+};
@@ -0,0 +1,151 @@
+#include "allocation_counter.hh"
+#include "application_state.hh"
+#include "test.hh"
+#include "thread_fixture.hh"
+#include "tile_decoder.hh"
+#include "tile_producer.hh"
+#include "tile_test_utils.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace tile_test;
+
+namespace
+{
+
+class ProducerFixture : public ThreadFixture
+{
+public:
+    // More tiles than fit in the cache, so that some are evicted
+    static constexpr auto kRowSize = 8u;
+    static constexpr auto kRows = 4u;
+    static constexpr auto kTiles = kRowSize * kRows;
+
+    ProducerFixture()
+    {
+        static_assert(kTiles > kMinTileCacheSize);
+
+        // The header, the FlashTile table and a copy of the tile for each entry
+        const auto rle = StripedRleTile();
+        const auto data_offset = sizeof(MapMetadata) + kTiles * sizeof(FlashTile);
+        MapMetadata metadata {};
+
+        metadata.magic = kMetadataMagic;
+        metadata.tile_count = kTiles + 1;
+        metadata.tile_row_size = kRowSize;
+        metadata.tile_rows = kRows;
+        metadata.tile_data_offset = sizeof(MapMetadata);
+
+        m_map.resize(data_offset + kTiles * rle.size());
+        memcpy(m_map.data(), &metadata, sizeof(metadata));
+        for (auto i = 0u; i < kTiles; i++)
+        {
+            FlashTile tile;
+
+            tile.size = rle.size();
+            tile.codec = static_cast<uint8_t>(TileCodec::kPaletteRle);
+            tile.flash_offset = data_offset + i * rle.size();
+            memcpy(m_map.data() + sizeof(MapMetadata) + i * sizeof(FlashTile), &tile, sizeof(tile));
+            std::ranges::copy(rle, m_map.begin() + tile.flash_offset);
+        }
+
+        producer = std::make_unique<TileProducer>(
+            m_application_state,
+            *reinterpret_cast<const MapMetadata*>(m_map.data()),
+            TileProducerConfig {.cache_size = kMinTileCacheSize, .flash = &m_flash});
+        SetThread(producer.get());
+    }
+
+    static Point TilePosition(unsigned index)
+    {
+        return {static_cast<int32_t>(index % kRowSize * kTileSize),
+                static_cast<int32_t>(index / kRowSize * kTileSize)};
+    }
+
+    std::unique_ptr<TileProducer> producer;
+
+private:
+    ApplicationState m_application_state;
+    CountingFlash m_flash;
+    std::vector<uint8_t> m_map;
+};
+
+} // namespace
+
+TEST_CASE("decoding tiles doesn't allocate memory")
+{
+    const auto rle = StripedRleTile();
+    TileDecoder decoder(std::max(kPngTile.size(), rle.size()));
+    IndexedTile tile;
+
+    auto counter = AllocationCounter();
+    for (auto i = 0; i < 4; i++)
+    {
+        auto staging = decoder.GetStagingBuffer(kPngTile.size());
+        std::ranges::copy(kPngTile, staging.begin());
+        REQUIRE(decoder.Decode(TileCodec::kPng, staging, tile));
+
+        staging = decoder.GetStagingBuffer(rle.size());
+        std::ranges::copy(rle, staging.begin());
+        REQUIRE(decoder.Decode(TileCodec::kPaletteRle, staging, tile));
+    }
+
+    REQUIRE(counter.Count() == 0);
+    REQUIRE(tile.pixels[0] == 0);
+    REQUIRE(tile.pixels[kTileSize] == 1);
+}
+
+TEST_CASE("decoding tiles straight from flash doesn't allocate memory")
+{
+    const auto rle = StripedRleTile();
+    TileDecoder decoder(rle.size());
+    CountingFlash flash;
+    IndexedTile tile;
+    std::vector<uint16_t> dst((kTileSize / 2) * (kTileSize / 2));
+
+    auto counter = AllocationCounter();
+    REQUIRE(
+        decoder.DecodeFromFlash(TileCodec::kPng, flash, kPngTile.data(), kPngTile.size(), tile));
+    REQUIRE(decoder.DecodeFromFlash(TileCodec::kPaletteRle, flash, rle.data(), rle.size(), tile));
+    REQUIRE(decoder.DecodeScaledFromFlash(
+        TileCodec::kPng, flash, kPngTile.data(), kPngTile.size(), 2, dst));
+    REQUIRE(decoder.DecodeScaledFromFlash(
+        TileCodec::kPaletteRle, flash, rle.data(), rle.size(), 2, dst));
+
+    REQUIRE(counter.Count() == 0);
+}
+
+TEST_CASE_FIXTURE(ProducerFixture, "the tile producer decodes and locks tiles without allocating")
+{
+    os::binary_semaphore ready {0};
+
+    // An activation without requests, which may allocate for the application state
+    auto idle = AllocationCounter();
+    DoRunLoop();
+    const auto idle_allocations = idle.Count();
+
+    // Twice around, i.e., decoded again after being evicted
+    for (auto i = 0u; i < 2 * kTiles; i++)
+    {
+        const auto at = TilePosition(i % kTiles);
+
+        // Not asserted meanwhile, since doctest may allocate
+        auto counter = AllocationCounter();
+        auto missing = producer->TryLockTile(at, ready);
+        DoRunLoop();
+        auto tile = producer->TryLockTile(at, ready);
+        const auto locked = tile != nullptr;
+        tile.reset();
+        const auto allocations = counter.Count();
+
+        REQUIRE_FALSE(missing);
+        REQUIRE(locked);
+        REQUIRE(allocations == idle_allocations);
+    }
+
+    REQUIRE(producer->GetStats().evictions > 0);
+    // Each TryLockTile miss waited until its tile was decoded
+    REQUIRE(producer->GetStats().lock_wait_time.count == 2 * kTiles);
+}
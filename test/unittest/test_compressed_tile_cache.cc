@@ -0,0 +1,110 @@
+#include "compressed_tile_cache.hh"
+#include "test.hh"
+
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+
+class CountingFlash : public hal::IFlash
+{
+public:
+    void Read(const uint8_t* src, std::span<uint8_t> dst) final
+    {
+        memcpy(dst.data(), src, dst.size());
+        reads++;
+    }
+
+    unsigned reads {0};
+};
+
+class Fixture
+{
+public:
+    Fixture()
+        : flash_data(16 * 100)
+    {
+        std::iota(flash_data.begin(), flash_data.end(), 0);
+    }
+
+    // Tile i is 100 bytes at i * 100
+    std::vector<uint8_t> Read(CompressedTileCache& cache, uint32_t index)
+    {
+        std::vector<uint8_t> out(100);
+
+        cache.Read(index, flash, flash_data.data() + index * 100, out);
+        return out;
+    }
+
+    std::vector<uint8_t> Expected(uint32_t index) const
+    {
+        return {flash_data.begin() + index * 100, flash_data.begin() + (index + 1) * 100};
+    }
+
+    CountingFlash flash;
+    std::vector<uint8_t> flash_data;
+};
+
+} // namespace
+
+TEST_CASE_FIXTURE(Fixture, "the compressed tile cache reads flash only on misses")
+{
+    CompressedTileCache cache(1024, 16);
+
+    REQUIRE(Read(cache, 3) == Expected(3));
+    REQUIRE(flash.reads == 1);
+    REQUIRE(Read(cache, 3) == Expected(3));
+    REQUIRE(flash.reads == 1);
+
+    auto stats = cache.GetStats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.flash_bytes == 100);
+    REQUIRE(stats.saved_flash_bytes == 100);
+}
+
+TEST_CASE_FIXTURE(Fixture, "the compressed tile cache drops the oldest tiles when full")
+{
+    // Room for 3 tiles
+    CompressedTileCache cache(350, 16);
+
+    for (auto i = 0u; i < 4; i++)
+    {
+        REQUIRE(Read(cache, i) == Expected(i));
+    }
+    REQUIRE(flash.reads == 4);
+
+    SUBCASE("the newest tiles are kept")
+    {
+        REQUIRE(Read(cache, 2) == Expected(2));
+        REQUIRE(Read(cache, 3) == Expected(3));
+        REQUIRE(flash.reads == 4);
+    }
+
+    SUBCASE("the oldest tile is gone")
+    {
+        REQUIRE(Read(cache, 0) == Expected(0));
+        REQUIRE(flash.reads == 5);
+    }
+
+    SUBCASE("the cache keeps working over many wrap arounds")
+    {
+        for (auto i = 0u; i < 64; i++)
+        {
+            REQUIRE(Read(cache, i % 16) == Expected(i % 16));
+            REQUIRE(Read(cache, i % 16) == Expected(i % 16));
+        }
+        REQUIRE(cache.GetStats().hits == 64);
+    }
+}
+
+TEST_CASE_FIXTURE(Fixture, "a zero-sized compressed tile cache always reads flash")
+{
+    CompressedTileCache cache(0, 16);
+
+    REQUIRE(Read(cache, 1) == Expected(1));
+    REQUIRE(Read(cache, 1) == Expected(1));
+    REQUIRE(flash.reads == 2);
+}
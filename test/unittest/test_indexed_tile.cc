@@ -0,0 +1,99 @@
+#include "hal/i_display.hh"
+#include "indexed_tile.hh"
+#include "test.hh"
+
+#include <vector>
+
+namespace
+{
+
+constexpr uint16_t kLand = 0xff99;
+constexpr uint16_t kWater = 0xae9b;
+
+// Land in the upper half, water in the lower
+IndexedTile
+HalfLandTile()
+{
+    IndexedTile tile;
+
+    tile.palette[0] = kLand;
+    tile.palette[1] = kWater;
+    for (auto i = 0u; i < tile.pixels.size(); i++)
+    {
+        tile.pixels[i] = i / kTileSize < kTileSize / 2 ? 0 : 1;
+    }
+
+    return tile;
+}
+
+} // namespace
+
+TEST_CASE("tiles are drawn with their palette")
+{
+    auto tile = HalfLandTile();
+    std::vector<uint16_t> frame_buffer(hal::kDisplayWidth * hal::kDisplayHeight);
+
+    tile.Blit(frame_buffer.data(), {10, 20});
+
+    REQUIRE(frame_buffer[20 * hal::kDisplayWidth + 9] == 0);
+    REQUIRE(frame_buffer[20 * hal::kDisplayWidth + 10] == kLand);
+    REQUIRE(frame_buffer[(20 + kTileSize - 1) * hal::kDisplayWidth + 10] == kWater);
+}
+
+TEST_CASE("the grayscale styles hatch the land when drawn")
+{
+    auto tile = HalfLandTile();
+    std::vector<uint16_t> frame_buffer(hal::kDisplayWidth * hal::kDisplayHeight);
+    const auto style = TileStyle {.grayscale = true, .hatch_color = 0xf800};
+
+    SUBCASE("full size")
+    {
+        tile.Blit(frame_buffer.data(), {0, 0}, style);
+
+        for (auto y = 0; y < kTileSize; y++)
+        {
+            for (auto x = 0; x < kTileSize; x++)
+            {
+                auto pixel = frame_buffer[y * hal::kDisplayWidth + x];
+                auto hatched = y < kTileSize / 2 && (x + y) % 6 < 2;
+
+                REQUIRE((pixel == 0xf800) == hatched);
+            }
+        }
+        // Gray water
+        auto water = frame_buffer[(kTileSize - 1) * hal::kDisplayWidth];
+        REQUIRE((water >> 11) == (water & 0x1f));
+    }
+
+    SUBCASE("zoomed out, with the pattern of the full size tile")
+    {
+        tile.ZoomedBlit(frame_buffer.data(), kTileSize / 3, 3, {0, 0}, style);
+
+        for (auto y = 0; y < kTileSize / 3; y++)
+        {
+            for (auto x = 0; x < kTileSize / 3; x++)
+            {
+                auto pixel = frame_buffer[y * kTileSize / 3 + x];
+                auto hatched = y * 3 < kTileSize / 2 && (x * 3 + y * 3) % 6 < 2;
+
+                REQUIRE((pixel == 0xf800) == hatched);
+            }
+        }
+    }
+
+    SUBCASE("clipped")
+    {
+        tile.Blit(frame_buffer.data(), {-7, -5}, style);
+
+        for (auto y = 0; y < 50; y++)
+        {
+            for (auto x = 0; x < 50; x++)
+            {
+                auto pixel = frame_buffer[y * hal::kDisplayWidth + x];
+                auto hatched = (x + 7 + y + 5) % 6 < 2;
+
+                REQUIRE((pixel == 0xf800) == hatched);
+            }
+        }
+    }
+}
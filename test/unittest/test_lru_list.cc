@@ -0,0 +1,73 @@
+#include "lru_list.hh"
+#include "test.hh"
+
+#include <vector>
+
+namespace
+{
+
+std::vector<uint16_t>
+Order(const LruList& lru)
+{
+    std::vector<uint16_t> out;
+
+    for (auto index = lru.LeastRecent(); index; index = lru.MoreRecent(*index))
+    {
+        out.push_back(*index);
+    }
+
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("the LRU list is empty at first")
+{
+    LruList lru(4);
+
+    REQUIRE(lru.LeastRecent() == std::nullopt);
+    REQUIRE_FALSE(lru.IsLinked(0));
+}
+
+TEST_CASE("the LRU list promotes used entries")
+{
+    LruList lru(4);
+
+    for (auto i = 0; i < 4; i++)
+    {
+        lru.PushMostRecent(i);
+    }
+    REQUIRE(Order(lru) == std::vector<uint16_t> {0, 1, 2, 3});
+
+    lru.PushMostRecent(1);
+    REQUIRE(Order(lru) == std::vector<uint16_t> {0, 2, 3, 1});
+
+    lru.PushLeastRecent(3);
+    REQUIRE(Order(lru) == std::vector<uint16_t> {3, 0, 2, 1});
+}
+
+TEST_CASE("unlinked entries are skipped by the LRU list")
+{
+    LruList lru(3);
+
+    for (auto i = 0; i < 3; i++)
+    {
+        lru.PushMostRecent(i);
+    }
+
+    lru.Unlink(0);
+    REQUIRE_FALSE(lru.IsLinked(0));
+    REQUIRE(Order(lru) == std::vector<uint16_t> {1, 2});
+
+    // Unlinking twice is harmless
+    lru.Unlink(0);
+    REQUIRE(Order(lru) == std::vector<uint16_t> {1, 2});
+
+    lru.Unlink(2);
+    lru.Unlink(1);
+    REQUIRE(lru.LeastRecent() == std::nullopt);
+
+    lru.PushMostRecent(0);
+    REQUIRE(lru.IsLinked(0));
+    REQUIRE(Order(lru) == std::vector<uint16_t> {0});
+}
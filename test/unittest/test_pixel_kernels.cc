@@ -0,0 +1,93 @@
+#include "pixel_kernels.hh"
+#include "test.hh"
+
+#include <array>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+constexpr auto kRowLength = 243;
+
+class Fixture
+{
+public:
+    Fixture()
+        : indices(kRowLength * 4)
+    {
+        std::mt19937 rng(1);
+
+        for (auto& index : indices)
+        {
+            index = rng() % 256;
+        }
+        for (auto i = 0u; i < palette.size(); i++)
+        {
+            palette[i] = rng();
+            // Every third entry is land
+            hatched_palette[i] = i % 3 == 0 ? 0xf800 : palette[i];
+        }
+    }
+
+    std::vector<uint8_t> indices;
+    std::array<uint16_t, 256> palette;
+    std::array<uint16_t, 256> hatched_palette;
+};
+
+} // namespace
+
+TEST_CASE_FIXTURE(Fixture, "the indexed row kernel matches the reference")
+{
+    for (auto step = 1u; step <= 4; step++)
+    {
+        for (auto length : {0, 1, 3, 4, 5, 60, kRowLength})
+        {
+            std::vector<uint16_t> expected(length);
+            std::vector<uint16_t> out(length);
+
+            IndexedToRgb565RowReference(indices.data(), palette.data(), expected, step);
+            IndexedToRgb565Row(indices.data(), palette.data(), out, step);
+            REQUIRE(out == expected);
+        }
+    }
+}
+
+TEST_CASE_FIXTURE(Fixture, "the hatched row kernel matches the reference")
+{
+    for (auto step = 1u; step <= 4; step++)
+    {
+        for (auto phase = 0u; phase < 14; phase++)
+        {
+            std::vector<uint16_t> expected(kRowLength);
+            std::vector<uint16_t> out(kRowLength);
+
+            HatchedIndexedToRgb565RowReference(
+                indices.data(), palette.data(), hatched_palette.data(), phase, expected, step);
+            HatchedIndexedToRgb565Row(
+                indices.data(), palette.data(), hatched_palette.data(), phase, out, step);
+            REQUIRE(out == expected);
+        }
+    }
+}
+
+TEST_CASE("the ARGB8888 row kernel matches the reference for all colors")
+{
+    std::vector<uint16_t> pixels(0x10000);
+    for (auto i = 0u; i < pixels.size(); i++)
+    {
+        pixels[i] = i;
+    }
+
+    std::vector<uint8_t> expected(pixels.size() * 4);
+    std::vector<uint8_t> out(pixels.size() * 4);
+
+    for (auto mask : {std::optional<uint16_t> {}, std::optional<uint16_t> {0xf81f}})
+    {
+        Rgb565ToArgb8888RowReference(pixels, expected.data(), mask);
+        Rgb565ToArgb8888Row(pixels, out.data(), mask);
+        REQUIRE(out == expected);
+    }
+    REQUIRE(out[0xf81f * 4 + 3] == 0);
+    REQUIRE(out[0xffff * 4] == 255);
+}
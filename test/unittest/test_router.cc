@@ -4,8 +4,58 @@
 #include "test.hh"
 #include "route_test_utils.hh"
 
+#include <algorithm>
+
 using namespace route_test;
 
+namespace
+{
+
+std::vector<uint32_t>
+PackLandMask(const std::vector<bool>& land_mask)
+{
+    std::vector<uint32_t> out;
+
+    // Save land mask as uint32_t values
+    uint32_t cur_val = 0;
+    int i;
+    for (i = 0; i < land_mask.size(); ++i)
+    {
+        cur_val |= land_mask[i] << (i % 32);
+        if ((i + 1) % 32 == 0)
+        {
+            out.push_back(cur_val);
+            cur_val = 0;
+        }
+    }
+    if (land_mask.size() % 32 != 0)
+    {
+        // Fill the remaining bits with 1s (as land)
+        cur_val |= 0xffffffff >> (i % 32);
+        out.push_back(cur_val);
+    }
+
+    return out;
+}
+
+// The cluster graph of the fixture land mask, with 8x8 clusters, as from tools/route_data.py
+std::vector<uint32_t>
+FixtureRouteClusters()
+{
+    return {
+        // clang-format off
+        8, 2, 1, 4, 8,                    // RouteClusterHeader
+        0, 2, 4,                          // first_node
+        23, 0, 119, 2, 24, 4, 120, 6,     // nodes
+        0xffffffff, 8,
+        1, 80, 2, 12, 0, 80, 3, 7,        // edges
+        0, 12, 3, 74, 1, 12, 2, 79,
+        // clang-format on
+    };
+}
+
+} // namespace
+
 class Fixture
 {
 public:
@@ -30,33 +80,18 @@ public:
             // clang-format on
         };
 
-        // Save land mask as uint32_t values
-        uint32_t cur_val = 0;
-        int i;
-        for (i = 0; i < land_mask.size(); ++i)
-        {
-            cur_val |= land_mask[i] << (i % 32);
-            if ((i + 1) % 32 == 0)
-            {
-                m_land_mask_uint32.push_back(cur_val);
-                cur_val = 0;
-            }
-        }
-        if (land_mask.size() % 32 != 0)
-        {
-            // Fill the remaining bits with 1s (as land)
-            cur_val |= 0xffffffff >> (i % 32);
-            m_land_mask_uint32.push_back(cur_val);
-        }
-
+        m_land_mask_uint32 = PackLandMask(land_mask);
 
-        router = std::make_unique<Router<kUnitTestCacheSize>>(m_land_mask_uint32, 8, kRowSize);
+        router = std::make_unique<Router<HashNodeStore<kUnitTestCacheSize>>>(
+            m_land_mask_uint32, 8, kRowSize);
+        dense_router = std::make_unique<Router<DenseNodeStore>>(m_land_mask_uint32, 8, kRowSize);
     }
 
-    std::unique_ptr<Router<kUnitTestCacheSize>> router;
+    std::unique_ptr<Router<HashNodeStore<kUnitTestCacheSize>>> router;
+    std::unique_ptr<Router<DenseNodeStore>> dense_router;
     std::vector<bool> land_mask;
 
-private:
+protected:
     std::vector<uint32_t> m_land_mask_uint32;
 };
 
@@ -113,6 +148,128 @@ TEST_CASE_FIXTURE(Fixture, "the router can merge partial paths")
 }
 
 
+TEST_CASE_FIXTURE(Fixture, "the dense node store finds long routes in a single search")
+{
+    auto r0 = AsVector(dense_router->CalculateRoute(ToPoint(0, 7), ToPoint(0, 5)));
+
+    REQUIRE_FALSE(r0.empty());
+    REQUIRE(dense_router->GetStats().partial_paths == 0);
+    REQUIRE(r0.front() == ToIndex(0, 7));
+    REQUIRE(r0.back() == ToIndex(0, 5));
+
+    auto r1 = dense_router->CalculateRoute(ToPoint(15, 8), ToPoint(4, 8));
+    REQUIRE(r1.empty());
+
+    // Nothing is cleared between the searches, also not when the generation wraps. Each route is
+    // at least one search
+    for (auto i = 0u; i <= DenseNodeStore::kMaxGeneration; i++)
+    {
+        auto r = dense_router->CalculateRoute(ToPoint(0, 7), ToPoint(0, 5));
+
+        REQUIRE(AsVector(r) == r0);
+        REQUIRE(dense_router->GetStats().partial_paths == 0);
+    }
+}
+
+
+TEST_CASE_FIXTURE(Fixture, "the dense node store refuses a too large g")
+{
+    auto store = DenseNodeStore(m_land_mask_uint32, kRowSize);
+    RouterNode node;
+
+    store.Reset();
+    REQUIRE(store.Update(ToIndex(0, 0), {.g = (1u << 22) - 1, .state = NodeState::kOpen}));
+    REQUIRE(store.Lookup(ToIndex(0, 0), node));
+    REQUIRE(node.g == (1u << 22) - 1);
+
+    // Not clamped, which would give the wrong route
+    REQUIRE_FALSE(store.Update(ToIndex(0, 0), {.g = 1u << 22, .state = NodeState::kOpen}));
+}
+
+
+TEST_CASE_FIXTURE(Fixture, "the router can search from both ends")
+{
+    dense_router->SetBidirectional(true);
+
+    // Around the island, possibly on the other side than from the start only
+    auto r0 = AsVector(dense_router->CalculateRoute(ToPoint(0, 7), ToPoint(0, 5)));
+    REQUIRE(r0.size() >= 2);
+    REQUIRE(r0.front() == ToIndex(0, 7));
+    REQUIRE(r0.back() == ToIndex(0, 5));
+    REQUIRE(dense_router->GetStats().partial_paths == 0);
+
+    auto r1 = AsVector(dense_router->CalculateRoute(ToPoint(0, 0), ToPoint(5, 0)));
+    REQUIRE(r1 == std::vector<IndexType> {ToIndex(0, 0), ToIndex(5, 0)});
+
+    auto r2 = dense_router->CalculateRoute(ToPoint(15, 8), ToPoint(4, 8));
+    REQUIRE(r2.empty());
+}
+
+
+TEST_CASE_FIXTURE(Fixture, "the router can route hierarchically between clusters")
+{
+    auto data = FixtureRouteClusters();
+    auto clusters = reinterpret_cast<const RouteClusterHeader*>(data.data());
+    auto hierarchical = Router<DenseNodeStore>(m_land_mask_uint32, 8, kRowSize, clusters);
+
+    auto r0 = AsVector(hierarchical.CalculateRoute(ToPoint(0, 0), ToPoint(10, 7)));
+    auto stats = hierarchical.GetStats();
+
+    REQUIRE(r0.size() > 2);
+    REQUIRE(r0.front() == ToIndex(0, 0));
+    REQUIRE(r0.back() == ToIndex(10, 7));
+    REQUIRE(stats.abstract_nodes_expanded > 0);
+    REQUIRE(stats.partial_paths == 0);
+
+    // Within a cluster, the cluster graph is not used
+    auto r1 = hierarchical.CalculateRoute(ToPoint(0, 0), ToPoint(5, 5));
+    REQUIRE_FALSE(r1.empty());
+    REQUIRE(hierarchical.GetStats().abstract_nodes_expanded == 0);
+
+    SUBCASE("without a way through the cluster graph, the full search is used")
+    {
+        // No nodes at all
+        auto empty = std::vector<uint32_t> {8, 2, 1, 0, 0, 0, 0, 0, 0xffffffff, 0};
+        auto empty_clusters = reinterpret_cast<const RouteClusterHeader*>(empty.data());
+        auto fallback = Router<DenseNodeStore>(m_land_mask_uint32, 8, kRowSize, empty_clusters);
+
+        auto r2 = AsVector(fallback.CalculateRoute(ToPoint(0, 0), ToPoint(10, 7)));
+        REQUIRE(r2.size() > 2);
+        REQUIRE(r2.front() == ToIndex(0, 0));
+        REQUIRE(r2.back() == ToIndex(10, 7));
+    }
+}
+
+
+TEST_CASE("the router keeps routes mid-channel")
+{
+    constexpr auto L = true;
+    constexpr auto w = false;
+
+    // A 16x7 channel
+    auto land_mask = PackLandMask({
+        // clang-format off
+        L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+        w, w, w, w, w, w, w, w, w, w, w, w, w, w, w, w,
+        w, w, w, w, w, w, w, w, w, w, w, w, w, w, w, w,
+        w, w, w, w, w, w, w, w, w, w, w, w, w, w, w, w,
+        w, w, w, w, w, w, w, w, w, w, w, w, w, w, w, w,
+        w, w, w, w, w, w, w, w, w, w, w, w, w, w, w, w,
+        L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+        // clang-format on
+    });
+    auto router = Router<DenseNodeStore>(land_mask, 7, kRowSize);
+
+    // Along the shore, but the route should move out to the middle of the channel
+    auto r0 = router.CalculateRoute(ToPoint(0, 1), ToPoint(15, 1));
+
+    REQUIRE(r0.size() > 2);
+    REQUIRE(r0.front() == ToIndex(0, 1));
+    REQUIRE(r0.back() == ToIndex(15, 1));
+    REQUIRE(std::ranges::any_of(r0, [](auto index) { return index / kRowSize == 3; }));
+}
+
+
 TEST_CASE_FIXTURE(Fixture, "the router can do diagonal paths")
 {
     auto r0 = router->CalculateRoute(ToPoint(0, 0), ToPoint(3, 3));
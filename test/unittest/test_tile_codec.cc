@@ -0,0 +1,91 @@
+#include "test.hh"
+#include "tile_codec.hh"
+
+#include <array>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t>
+Header(std::initializer_list<uint16_t> palette)
+{
+    std::vector<uint8_t> out {static_cast<uint8_t>(palette.size())};
+
+    for (auto color : palette)
+    {
+        out.push_back(color & 0xff);
+        out.push_back(color >> 8);
+    }
+
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("short and long palette runs are decoded")
+{
+    auto data = Header({0xff99, 0xae9b});
+
+    // 2x color 1, 1x color 0, 300 (4 + 255, 4 + 37) x color 1
+    data.insert(data.end(), {(1 << 6) | 1, 0, (3 << 6) | 1, 255, (3 << 6) | 1, 37});
+
+    std::vector<uint8_t> dst(303);
+    std::array<uint16_t, kPaletteRleMaxColors> palette;
+    REQUIRE(DecodePaletteRleTile(data, dst, palette));
+
+    REQUIRE(palette[0] == 0xff99);
+    REQUIRE(palette[1] == 0xae9b);
+
+    REQUIRE(dst[0] == 1);
+    REQUIRE(dst[1] == 1);
+    REQUIRE(dst[2] == 0);
+    REQUIRE(std::ranges::count(dst, 1) == 302);
+    REQUIRE(dst.back() == 1);
+}
+
+TEST_CASE("corrupt palette run-length tiles are rejected")
+{
+    std::vector<uint8_t> dst(4);
+    std::array<uint16_t, kPaletteRleMaxColors> palette;
+
+    SUBCASE("empty data")
+    {
+        REQUIRE_FALSE(DecodePaletteRleTile({}, dst, palette));
+    }
+
+    SUBCASE("truncated palette")
+    {
+        auto data = Header({0x1234, 0x5678});
+        data.pop_back();
+        REQUIRE_FALSE(DecodePaletteRleTile(data, dst, palette));
+    }
+
+    SUBCASE("palette index out of range")
+    {
+        auto data = Header({0x1234});
+        data.insert(data.end(), {(3 << 6) | 1, 0});
+        REQUIRE_FALSE(DecodePaletteRleTile(data, dst, palette));
+    }
+
+    SUBCASE("too few pixels")
+    {
+        auto data = Header({0x1234});
+        data.push_back((2 << 6) | 0);
+        REQUIRE_FALSE(DecodePaletteRleTile(data, dst, palette));
+    }
+
+    SUBCASE("too many pixels")
+    {
+        auto data = Header({0x1234});
+        data.insert(data.end(), {(3 << 6) | 0, 1});
+        REQUIRE_FALSE(DecodePaletteRleTile(data, dst, palette));
+    }
+
+    SUBCASE("trailing data")
+    {
+        auto data = Header({0x1234});
+        data.insert(data.end(), {(3 << 6) | 0, 0, 0});
+        REQUIRE_FALSE(DecodePaletteRleTile(data, dst, palette));
+    }
+}
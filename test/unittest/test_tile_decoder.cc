@@ -0,0 +1,371 @@
+#include "palette_png_decoder.hh"
+#include "test.hh"
+#include "tile_codec.hh"
+#include "tile_decoder.hh"
+#include "tile_test_utils.hh"
+
+#include <array>
+#include <cstdlib>
+#include <vector>
+
+using namespace tile_test;
+
+namespace
+{
+
+// The tiles of the PNG test map
+constexpr auto kTestMapRowSize = 4u;
+constexpr auto kTestMapRows = 3u;
+
+// The palette indices of a PNG test map tile
+std::vector<uint8_t>
+TestImage(unsigned tile_x = 0, unsigned tile_y = 0)
+{
+    std::vector<uint8_t> out(kTileSize * kTileSize);
+
+    for (auto y = 0u; y < kTileSize; y++)
+    {
+        for (auto x = 0u; x < kTileSize; x++)
+        {
+            const auto map_x = tile_x * kTileSize + x;
+            const auto map_y = tile_y * kTileSize + y;
+
+            out[y * kTileSize + x] = (map_x / 8 + map_y / 5 + (map_x * map_y) % 7) % 64;
+        }
+    }
+
+    return out;
+}
+
+void
+PushUint32(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.insert(out.end(), {static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+                           static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)});
+}
+
+// CRCs are not checked, so left as zero
+void
+PushChunk(std::vector<uint8_t>& out, const char* type, std::span<const uint8_t> data)
+{
+    PushUint32(out, data.size());
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PushUint32(out, 0);
+}
+
+// A PNG with the rows filtered by filter type y % 5, and stored (uncompressed) deflate blocks
+// split over several IDAT chunks
+std::vector<uint8_t>
+StoredPng(std::span<const uint8_t> image, unsigned size = kTileSize, uint8_t bit_depth = 8)
+{
+    std::vector<uint8_t> filtered;
+    for (auto y = 0u; y < size; y++)
+    {
+        const auto filter = y % 5;
+        auto row = image.data() + y * size;
+        auto above = y == 0 ? nullptr : row - size;
+        auto prior = [&](unsigned x) { return above ? above[x] : 0; };
+        auto left = [&](unsigned x) { return x == 0 ? 0 : row[x - 1]; };
+        auto upper_left = [&](unsigned x) { return x == 0 || !above ? 0 : above[x - 1]; };
+
+        filtered.push_back(filter);
+        for (auto x = 0u; x < size; x++)
+        {
+            int a = left(x);
+            int b = prior(x);
+            int c = upper_left(x);
+            int p = a + b - c;
+            int paeth = std::abs(p - a) <= std::abs(p - b) && std::abs(p - a) <= std::abs(p - c)
+                            ? a
+                        : std::abs(p - b) <= std::abs(p - c) ? b
+                                                             : c;
+            std::array<int, 5> predicted {0, a, b, (a + b) / 2, paeth};
+
+            filtered.push_back(static_cast<uint8_t>(row[x] - predicted[filter]));
+        }
+    }
+
+    std::vector<uint8_t> zlib {0x78, 0x01};
+    for (auto offset = 0u; offset < filtered.size(); offset += 1000)
+    {
+        const auto length = std::min<size_t>(1000, filtered.size() - offset);
+        const auto last = offset + length == filtered.size();
+
+        zlib.insert(zlib.end(),
+                    {static_cast<uint8_t>(last),
+                     static_cast<uint8_t>(length),
+                     static_cast<uint8_t>(length >> 8),
+                     static_cast<uint8_t>(~length),
+                     static_cast<uint8_t>(~length >> 8)});
+        zlib.insert(zlib.end(), filtered.begin() + offset, filtered.begin() + offset + length);
+    }
+    // The Adler-32 checksum, for PNGdec
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (auto byte : filtered)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    PushUint32(zlib, b << 16 | a);
+
+    std::vector<uint8_t> out {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<uint8_t> ihdr;
+    PushUint32(ihdr, size);
+    PushUint32(ihdr, size);
+    ihdr.insert(ihdr.end(), {bit_depth, 3, 0, 0, 0});
+    PushChunk(out, "IHDR", ihdr);
+
+    std::vector<uint8_t> palette;
+    for (auto i = 0u; i < 64; i++)
+    {
+        palette.insert(palette.end(), {static_cast<uint8_t>(i * 4), 0x80, 0xff});
+    }
+    PushChunk(out, "PLTE", palette);
+
+    for (auto offset = 0u; offset < zlib.size(); offset += 4096)
+    {
+        PushChunk(out,
+                  "IDAT",
+                  std::span(zlib).subspan(offset, std::min<size_t>(4096, zlib.size() - offset)));
+    }
+    PushChunk(out, "IEND", {});
+
+    return out;
+}
+
+void
+CopyRow(void* user, unsigned y, const uint8_t* indices)
+{
+    auto image = static_cast<std::vector<uint8_t>*>(user);
+
+    std::copy_n(indices, kTileSize, image->begin() + y * kTileSize);
+}
+
+} // namespace
+
+TEST_CASE("palette PNG tiles are decoded to indices")
+{
+    TileDecoder decoder(kPngTile.size());
+    IndexedTile tile;
+
+    REQUIRE(decoder.Decode(TileCodec::kPng, kPngTile, tile));
+
+    REQUIRE(tile.palette[0] == 0xf800);
+    REQUIRE(tile.palette[3] == 0xff99);
+    REQUIRE(tile.pixels[0] == 0);
+    REQUIRE(tile.pixels[60] == 1);
+    REQUIRE(tile.pixels[239] == 3);
+    REQUIRE(tile.pixels[60 * kTileSize] == 1);
+    REQUIRE(tile.pixels[239 * kTileSize + 239] == 2);
+}
+
+TEST_CASE("tiles of the wrong size are rejected")
+{
+    TileDecoder decoder(kPngTile.size());
+    IndexedTile tile;
+    auto rle = StripedRleTile();
+
+    rle.pop_back();
+    REQUIRE_FALSE(decoder.Decode(TileCodec::kPaletteRle, rle, tile));
+    REQUIRE_FALSE(decoder.Decode(TileCodec::kPng, std::span(kPngTile).first(100), tile));
+}
+
+TEST_CASE("tiles can be decoded straight from flash")
+{
+    const auto rle = StripedRleTile();
+    CountingFlash flash;
+    IndexedTile tile;
+
+    SUBCASE("PNG tiles don't need the staging buffer")
+    {
+        TileDecoder decoder(0);
+
+        REQUIRE(decoder.DecodeFromFlash(
+            TileCodec::kPng, flash, kPngTile.data(), kPngTile.size(), tile));
+
+        REQUIRE(flash.bytes == kPngTile.size());
+        REQUIRE(tile.palette[3] == 0xff99);
+        REQUIRE(tile.pixels[239] == 3);
+        REQUIRE(tile.pixels[239 * kTileSize + 239] == 2);
+    }
+
+    SUBCASE("other codecs are copied to the staging buffer")
+    {
+        TileDecoder decoder(rle.size());
+
+        REQUIRE(decoder.DecodeFromFlash(
+            TileCodec::kPaletteRle, flash, rle.data(), rle.size(), tile));
+        REQUIRE(flash.bytes == rle.size());
+        REQUIRE(flash.reads == 1);
+        REQUIRE(tile.pixels[kTileSize] == 1);
+    }
+
+    SUBCASE("truncated tiles are rejected")
+    {
+        TileDecoder decoder(0);
+
+        REQUIRE_FALSE(decoder.DecodeFromFlash(TileCodec::kPng, flash, kPngTile.data(), 100, tile));
+    }
+}
+
+TEST_CASE("tiles can be decoded downscaled to RGB565")
+{
+    constexpr auto kFactor = 3u;
+    constexpr auto kSize = kTileSize / kFactor;
+
+    const auto rle = StripedRleTile();
+    CountingFlash flash;
+    TileDecoder decoder(rle.size());
+    IndexedTile tile;
+    std::vector<uint16_t> expected(kSize * kSize);
+    std::vector<uint16_t> dst(kSize * kSize);
+
+    // Same as drawing the full tile zoomed out, in all color modes
+    auto check = [&](TileCodec codec, std::span<const uint8_t> data) {
+        for (const auto& style : {TileStyle {}, TileStyle {.grayscale = true, .hatch_color = 1}})
+        {
+            REQUIRE(decoder.Decode(codec, data, tile));
+            tile.ZoomedBlit(expected.data(), kSize, kFactor, {0, 0}, style);
+
+            REQUIRE(decoder.DecodeScaledFromFlash(
+                codec, flash, data.data(), data.size(), kFactor, dst, style));
+            REQUIRE(dst == expected);
+        }
+    };
+
+    SUBCASE("PNG tiles")
+    {
+        check(TileCodec::kPng, kPngTile);
+    }
+
+    SUBCASE("palette run-length tiles")
+    {
+        check(TileCodec::kPaletteRle, rle);
+    }
+
+    SUBCASE("factors which don't match the destination are rejected")
+    {
+        REQUIRE_FALSE(decoder.DecodeScaledFromFlash(
+            TileCodec::kPng, flash, kPngTile.data(), kPngTile.size(), 7, dst));
+        REQUIRE_FALSE(decoder.DecodeScaledFromFlash(
+            TileCodec::kPng, flash, kPngTile.data(), kPngTile.size(), 2, dst));
+    }
+}
+
+TEST_CASE("the palette PNG decoder handles all row filters")
+{
+    const auto image = TestImage();
+    const auto png = StoredPng(image);
+    PalettePngDecoder decoder;
+    std::array<uint16_t, 256> palette;
+    std::vector<uint8_t> decoded(image.size());
+
+    SUBCASE("from memory")
+    {
+        REQUIRE(decoder.Decode(png, palette, CopyRow, &decoded) ==
+                PalettePngDecoder::Result::kDecoded);
+    }
+
+    SUBCASE("from flash, in small chunks")
+    {
+        CountingFlash flash;
+
+        REQUIRE(decoder.Decode(flash, png.data(), png.size(), palette, CopyRow, &decoded) ==
+                PalettePngDecoder::Result::kDecoded);
+        REQUIRE(flash.reads > 1);
+        REQUIRE(flash.bytes <= png.size());
+    }
+
+    REQUIRE(decoded == image);
+    REQUIRE(palette[1] == ((4 >> 3) << 11 | (0x80 >> 2) << 5 | (0xff >> 3)));
+    REQUIRE(palette[64] == 0);
+}
+
+TEST_CASE("the palette PNG decoder matches PNGdec")
+{
+    // All tiles of the test map, and the map tile
+    std::vector<std::vector<uint8_t>> tiles {{kPngTile.begin(), kPngTile.end()}};
+    for (auto y = 0u; y < kTestMapRows; y++)
+    {
+        for (auto x = 0u; x < kTestMapRowSize; x++)
+        {
+            tiles.push_back(StoredPng(TestImage(x, y)));
+        }
+    }
+
+    for (const auto& png : tiles)
+    {
+        TileDecoder decoder(png.size());
+        TileDecoder pngdec(png.size(), false);
+        IndexedTile tile;
+        IndexedTile expected;
+
+        REQUIRE(decoder.Decode(TileCodec::kPng, png, tile));
+        REQUIRE(pngdec.Decode(TileCodec::kPng, png, expected));
+
+        REQUIRE(tile.pixels == expected.pixels);
+
+        // PNGdec copies all 256 entries, also past the PLTE chunk
+        std::array<bool, 256> used {};
+        for (auto index : tile.pixels)
+        {
+            used[index] = true;
+        }
+        for (auto index = 0u; index < used.size(); index++)
+        {
+            REQUIRE((!used[index] || tile.palette[index] == expected.palette[index]));
+        }
+    }
+}
+
+TEST_CASE("the palette PNG decoder leaves other PNGs to PNGdec")
+{
+    PalettePngDecoder decoder;
+    std::array<uint16_t, 256> palette;
+    std::vector<uint8_t> decoded(kTileSize * kTileSize);
+    const auto image = TestImage();
+
+    SUBCASE("other sizes")
+    {
+        auto png = StoredPng(std::span(image).first(16 * 16), 16);
+        REQUIRE(decoder.Decode(png, palette, CopyRow, &decoded) ==
+                PalettePngDecoder::Result::kUnsupported);
+    }
+
+    SUBCASE("other bit depths")
+    {
+        auto png = StoredPng(image, kTileSize, 4);
+        REQUIRE(decoder.Decode(png, palette, CopyRow, &decoded) ==
+                PalettePngDecoder::Result::kUnsupported);
+    }
+
+    SUBCASE("not a PNG")
+    {
+        REQUIRE(decoder.Decode(StripedRleTile(), palette, CopyRow, &decoded) ==
+                PalettePngDecoder::Result::kUnsupported);
+    }
+}
+
+TEST_CASE("the palette PNG decoder rejects corrupt tiles")
+{
+    PalettePngDecoder decoder;
+    std::array<uint16_t, 256> palette;
+    std::vector<uint8_t> decoded(kTileSize * kTileSize);
+    auto png = std::vector<uint8_t>(kPngTile.begin(), kPngTile.end());
+
+    SUBCASE("truncated")
+    {
+        png.resize(png.size() - 40);
+    }
+
+    SUBCASE("garbage in the compressed data")
+    {
+        // In the IDAT chunk, after the zlib header
+        std::fill_n(png.begin() + 75, 16, 0xff);
+    }
+
+    REQUIRE(decoder.Decode(png, palette, CopyRow, &decoded) ==
+            PalettePngDecoder::Result::kCorrupt);
+}
@@ -0,0 +1,215 @@
+#include "test.hh"
+#include "tile_request_queue.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Request
+{
+    unsigned producer;
+    unsigned sequence;
+};
+
+using Queue = TileRequestQueue<Request, 8>;
+
+std::optional<unsigned>
+PopSequence(Queue& queue, TilePriority lowest = TilePriority::kPrefetch)
+{
+    auto request = queue.Pop(lowest, [](const auto&) { FAIL("Unexpected cancel"); });
+
+    if (!request)
+    {
+        return std::nullopt;
+    }
+
+    return request->sequence;
+}
+
+} // namespace
+
+TEST_CASE("the tile request queue pops the highest priority first")
+{
+    Queue queue;
+
+    REQUIRE(queue.Push(TilePriority::kPrefetch, {0, 1}));
+    REQUIRE(queue.Push(TilePriority::kThumbnail, {0, 2}));
+    REQUIRE(queue.Push(TilePriority::kVisible, {0, 3}));
+    REQUIRE(queue.Push(TilePriority::kOverview, {0, 4}));
+    REQUIRE(queue.Push(TilePriority::kVisible, {0, 5}));
+    REQUIRE(queue.Size() == 5);
+
+    // FIFO within a priority class
+    REQUIRE(PopSequence(queue) == 3);
+    REQUIRE(PopSequence(queue) == 5);
+    REQUIRE(PopSequence(queue) == 4);
+
+    SUBCASE("lower priorities are left in the queue")
+    {
+        REQUIRE(PopSequence(queue, TilePriority::kOverview) == std::nullopt);
+        REQUIRE(PopSequence(queue, TilePriority::kThumbnail) == 2);
+        REQUIRE(PopSequence(queue, TilePriority::kThumbnail) == std::nullopt);
+    }
+
+    SUBCASE("everything is popped")
+    {
+        REQUIRE(PopSequence(queue) == 2);
+        REQUIRE(PopSequence(queue) == 1);
+        REQUIRE(PopSequence(queue) == std::nullopt);
+    }
+}
+
+TEST_CASE("the tile request queue is bounded per priority class")
+{
+    Queue queue;
+
+    for (auto i = 0u; i < 8; i++)
+    {
+        REQUIRE(queue.Push(TilePriority::kVisible, {0, i}));
+    }
+    REQUIRE_FALSE(queue.Push(TilePriority::kVisible, {0, 8}));
+    REQUIRE(queue.Push(TilePriority::kOverview, {0, 9}));
+}
+
+TEST_CASE("the tile request queue cancels superseded requests")
+{
+    Queue queue;
+    std::vector<unsigned> cancelled;
+    auto on_cancelled = [&cancelled](const auto& request) {
+        cancelled.push_back(request.sequence);
+    };
+
+    queue.Push(TilePriority::kVisible, {0, 1});
+    queue.Push(TilePriority::kVisible, {0, 2});
+    queue.Push(TilePriority::kOverview, {0, 3});
+    queue.Cancel(TilePriority::kVisible);
+    queue.Push(TilePriority::kVisible, {0, 4});
+
+    // Handed out as cancelled when popped
+    REQUIRE(queue.Size() == 4);
+
+    auto request = queue.Pop(TilePriority::kPrefetch, on_cancelled);
+    REQUIRE(request);
+    REQUIRE(request->sequence == 4);
+    REQUIRE(cancelled == std::vector<unsigned> {1, 2});
+
+    // Other classes are not affected
+    request = queue.Pop(TilePriority::kPrefetch, on_cancelled);
+    REQUIRE(request);
+    REQUIRE(request->sequence == 3);
+    REQUIRE(cancelled.size() == 2);
+}
+
+TEST_CASE("the tile request queue reports the cancelled requests right away")
+{
+    Queue queue;
+    std::vector<unsigned> cancelled;
+    auto on_cancel = [&cancelled](const auto& request) { cancelled.push_back(request.sequence); };
+
+    queue.Push(TilePriority::kVisible, {0, 1});
+    queue.Push(TilePriority::kOverview, {0, 2});
+    queue.Push(TilePriority::kVisible, {0, 3});
+    queue.Cancel(TilePriority::kVisible, on_cancel);
+    REQUIRE(cancelled == std::vector<unsigned> {1, 3});
+
+    // Only the ones cancelled now
+    cancelled.clear();
+    queue.Push(TilePriority::kVisible, {0, 4});
+    queue.Cancel(TilePriority::kVisible, on_cancel);
+    REQUIRE(cancelled == std::vector<unsigned> {4});
+
+    // Still handed out as cancelled when popped, in order
+    cancelled.clear();
+    auto request = queue.Pop(TilePriority::kPrefetch, on_cancel);
+    REQUIRE(request);
+    REQUIRE(request->sequence == 2);
+    REQUIRE(cancelled == std::vector<unsigned> {1, 3, 4});
+}
+
+TEST_CASE("the tile request queue can be used from several threads")
+{
+    constexpr auto kProducers = 4u;
+    constexpr auto kRequests = 20000u;
+
+    Queue queue;
+    std::atomic<unsigned> producers_done {0};
+
+    // Each request is either popped or cancelled, exactly once
+    std::vector<std::vector<uint8_t>> seen(kProducers, std::vector<uint8_t>(kRequests));
+    std::vector<std::array<int, 4>> last_popped(kProducers);
+    for (auto& last : last_popped)
+    {
+        last.fill(-1);
+    }
+    auto in_order = true;
+
+    auto consumer = std::thread([&]() {
+        auto on_cancelled = [&seen](const auto& request) {
+            seen[request.producer][request.sequence]++;
+        };
+
+        while (true)
+        {
+            auto done = producers_done == kProducers;
+            auto request = queue.Pop(TilePriority::kPrefetch, on_cancelled);
+
+            if (!request)
+            {
+                if (done)
+                {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+
+            seen[request->producer][request->sequence]++;
+
+            // FIFO per producer and priority class
+            auto& last = last_popped[request->producer][request->sequence % 4];
+            in_order = in_order && static_cast<int>(request->sequence) > last;
+            last = request->sequence;
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (auto producer = 0u; producer < kProducers; producer++)
+    {
+        producers.emplace_back([&queue, &producers_done, producer]() {
+            for (auto i = 0u; i < kRequests; i++)
+            {
+                auto priority = static_cast<TilePriority>(i % 4);
+
+                while (!queue.Push(priority, {producer, i}))
+                {
+                    std::this_thread::yield();
+                }
+
+                // Supersede the prefetch requests now and then
+                if (producer == 0 && i % 97 == 0)
+                {
+                    queue.Cancel(TilePriority::kPrefetch);
+                }
+            }
+            producers_done++;
+        });
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    consumer.join();
+
+    REQUIRE(in_order);
+    REQUIRE(queue.Size() == 0);
+    for (const auto& producer : seen)
+    {
+        REQUIRE(std::ranges::all_of(producer, [](auto count) { return count == 1; }));
+    }
+}
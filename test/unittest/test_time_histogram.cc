@@ -0,0 +1,47 @@
+#include "test.hh"
+#include "time_histogram.hh"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("an empty time histogram is zero")
+{
+    TimeHistogram histogram;
+
+    REQUIRE(histogram.count == 0);
+    REQUIRE(histogram.Average().count() == 0);
+    REQUIRE(histogram.Percentile(50).count() == 0);
+    REQUIRE(histogram.Max().count() == 0);
+}
+
+TEST_CASE("the time histogram records durations in power of two buckets")
+{
+    TimeHistogram histogram;
+
+    for (auto i = 0; i < 90; i++)
+    {
+        histogram.Record(100us);
+    }
+    for (auto i = 0; i < 10; i++)
+    {
+        histogram.Record(20ms);
+    }
+
+    REQUIRE(histogram.count == 100);
+    REQUIRE(histogram.buckets[7] == 90);
+    REQUIRE(histogram.Average().count() == (90 * 100 + 10 * 20000) / 100);
+    REQUIRE(histogram.Max().count() == 20000);
+
+    // The upper bound of the 64..127us bucket
+    REQUIRE(histogram.Percentile(50).count() == 127);
+    REQUIRE(histogram.Percentile(90).count() == 127);
+    // Never above the maximum
+    REQUIRE(histogram.Percentile(95).count() == 20000);
+
+    SUBCASE("long durations end up in the last bucket")
+    {
+        histogram.Record(5s);
+
+        REQUIRE(histogram.buckets.back() == 1);
+        REQUIRE(histogram.Percentile(100).count() == 5000000);
+    }
+}
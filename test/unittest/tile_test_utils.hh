@@ -0,0 +1,79 @@
+#pragma once
+
+#include "hal/i_flash.hh"
+#include "tile.hh"
+#include "tile_codec.hh"
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+
+namespace tile_test
+{
+
+// 240x240 8-bit palette PNG: 60x60 squares of the colors 0..3, the last one the land color
+inline constexpr auto kPngTile = std::to_array<uint8_t>({
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0xf0, 0x00, 0x00, 0x00, 0xf0,
+    0x08, 0x03, 0x00, 0x00, 0x00, 0x09, 0x8b, 0x19, 0xa0, 0x00, 0x00, 0x00,
+    0x0c, 0x50, 0x4c, 0x54, 0x45, 0xff, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00,
+    0x00, 0xff, 0xfe, 0xf2, 0xcb, 0x6e, 0xd8, 0x80, 0x39, 0x00, 0x00, 0x01,
+    0x0f, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0xed, 0xd1, 0xa1, 0x0d, 0x00,
+    0x30, 0x0c, 0x03, 0xc1, 0xb4, 0xd9, 0x7f, 0xe7, 0xd2, 0xa2, 0x10, 0xa3,
+    0x48, 0xf7, 0x13, 0xf8, 0xe4, 0xaa, 0xa0, 0x13, 0x74, 0x83, 0x3a, 0xa8,
+    0x80, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x47, 0xb0, 0x97, 0x80, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+    0x81, 0x81, 0x81, 0x81, 0x81, 0xff, 0x36, 0x8e, 0x4e, 0x4e, 0x02, 0x06,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x9e, 0xc1, 0x1b, 0x47, 0x27, 0x27, 0x01,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x8f, 0x3d, 0x90, 0x78, 0x51, 0x90,
+    0x73, 0xe4, 0x9a, 0x8c, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44,
+    0xae, 0x42, 0x60, 0x82,
+});
+
+// Rows alternating between the colors 0 and 1
+inline std::vector<uint8_t>
+StripedRleTile()
+{
+    std::vector<uint8_t> out {2, 0x00, 0xf8, 0xe0, 0x07};
+
+    for (auto y = 0; y < kTileSize; y++)
+    {
+        out.push_back((kPaletteRleShortRuns << 6) | (y % 2));
+        out.push_back(kTileSize - kPaletteRleLongRunBase);
+    }
+
+    return out;
+}
+
+// Copies and counts the reads
+class CountingFlash : public hal::IFlash
+{
+public:
+    void Read(const uint8_t* src, std::span<uint8_t> dst) final
+    {
+        std::ranges::copy(std::span(src, dst.size()), dst.begin());
+        bytes += dst.size();
+        reads++;
+    }
+
+    size_t bytes {0};
+    unsigned reads {0};
+};
+
+} // namespace tile_test
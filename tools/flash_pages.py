@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+
+# Replay a recorded voyage (maelir_qt --record) over a map, and count the 64 KiB flash pages
+# which the visible tiles touch. The ESP32 maps the flash in 64 KiB MMU pages, so fewer pages
+# means fewer remaps and better cache reuse while panning.
+#
+# The tile layouts of tiler.py --layout are simulated from the tile sizes in the map, so any
+# map.bin can be used.
+
+import argparse
+import struct
+import sys
+
+from tiler import kTileLayouts, tile_order
+
+kPageSize = 64 * 1024
+
+# hal::kDisplayWidth/kDisplayHeight and kTileSize
+kDisplayWidth = 480
+kDisplayHeight = 480
+kTileSize = 240
+
+# MapMetadata in tile.hh
+kHeaderFormat = "<QffffIIIIIIIIIIII"
+
+
+def read_tiles(data: bytes):
+    """The (flash offset, size) of the full size tiles, row-major"""
+    header = struct.unpack_from(kHeaderFormat, data)
+    tile_row_size, tile_rows = header[6], header[7]
+    tile_data_offset = header[12]
+
+    tiles = []
+    for index in range(tile_row_size * tile_rows):
+        size, offset = struct.unpack_from("<II", data, tile_data_offset + index * 8)
+        tiles.append((offset, size & 0xFFFFFF))
+
+    return tile_row_size, tile_rows, tiles
+
+
+def read_voyage(path: str):
+    """The global pixel positions, one "x y" per line"""
+    out = []
+    for line in open(path, "r"):
+        line = line.split("#")[0].split()
+        if len(line) == 2:
+            out.append((int(line[0]), int(line[1])))
+
+    return out
+
+
+def layout_tiles(tiles: list, row_size: int, rows: int, layout: str):
+    """The tiles with their payloads moved to the layout order"""
+    # Shared payloads (open water, inland) are placed once, at the first tile using them
+    placed = {}
+    offset = min(offset for offset, _ in tiles)
+    out = [None] * len(tiles)
+
+    for index in tile_order(row_size, rows, layout):
+        original, size = tiles[index]
+        if original not in placed:
+            placed[original] = offset
+            offset += size
+        out[index] = (placed[original], size)
+
+    return out
+
+
+def visible_tiles(x: int, y: int, row_size: int, rows: int):
+    # Same as TileProducer::VisibleTiles, the display is centered around the position
+    max_x = max(0, row_size * kTileSize - kDisplayWidth)
+    max_y = max(0, rows * kTileSize - kDisplayHeight)
+    left = min(max(x - kDisplayWidth // 2, 0), max_x)
+    top = min(max(y - kDisplayHeight // 2, 0), max_y)
+
+    for tile_y in range(top // kTileSize, (top + kDisplayHeight - 1) // kTileSize + 1):
+        for tile_x in range(left // kTileSize, (left + kDisplayWidth - 1) // kTileSize + 1):
+            if tile_x < row_size and tile_y < rows:
+                yield tile_y * row_size + tile_x
+
+
+def replay(tiles: list, row_size: int, rows: int, voyage: list):
+    """Return the distinct pages, the pages mapped in (new compared to the previous screen),
+    and the average pages per screen"""
+    distinct = set()
+    previous = set()
+    mapped_in = 0
+    per_screen = 0
+
+    for x, y in voyage:
+        pages = set()
+        for index in visible_tiles(x, y, row_size, rows):
+            offset, size = tiles[index]
+            pages.update(range(offset // kPageSize, (offset + size - 1) // kPageSize + 1))
+
+        distinct |= pages
+        mapped_in += len(pages - previous)
+        per_screen += len(pages)
+        previous = pages
+
+    return len(distinct), mapped_in, per_screen / max(len(voyage), 1)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Count the 64 KiB flash pages touched along a voyage, per tile layout"
+    )
+    parser.add_argument("map_file")
+    parser.add_argument("voyage_file", help="Global pixel positions, one 'x y' per line")
+    args = parser.parse_args()
+
+    data = open(args.map_file, "rb").read()
+    row_size, rows, tiles = read_tiles(data)
+    voyage = read_voyage(args.voyage_file)
+    if not voyage:
+        print("Error: no positions in {}".format(args.voyage_file))
+        sys.exit(1)
+
+    print("{} positions, {}x{} tiles".format(len(voyage), row_size, rows))
+    print("{:>10} {:>15} {:>15} {:>15}".format("layout", "distinct pages", "mapped in", "per screen"))
+
+    layouts = [("map.bin", tiles)]
+    layouts += [(layout, layout_tiles(tiles, row_size, rows, layout)) for layout in kTileLayouts]
+    for name, layout in layouts:
+        distinct, mapped_in, per_screen = replay(layout, row_size, rows, voyage)
+        print("{:>10} {:>15} {:>15} {:>15.2f}".format(name, distinct, mapped_in, per_screen))
@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+
+# The precomputed routing data in map.bin. The costs are the same as in the router
+# (src/router/router.cc), apart from the bonus for going straight.
+
+import heapq
+import struct
+
+# The extra cost to move into a cell, by its distance to land (kClearanceCost)
+kClearanceCost = [0, 8, 3, 1]
+
+# Segments along a cluster border at least this long get a node at each end, otherwise one in
+# the middle
+kLongEntrance = 6
+
+kNeighbors = [(dx, dy) for dy in (-1, 0, 1) for dx in (-1, 0, 1) if (dx, dy) != (0, 0)]
+
+
+def unpack_land_mask(words: list, cells: int):
+    """One bool per cell, True for water"""
+    out = [False] * cells
+    for index in range(min(cells, len(words) * 32)):
+        out[index] = (words[index // 32] >> (index % 32)) & 1 == 0
+
+    return out
+
+
+def clearance(water: list, row_size: int, rows: int):
+    """The chessboard distance to land for each cell, the same as Router::CalculateClearance"""
+    out = [255 if w else 0 for w in water]
+
+    def relax(x, y, dx, dy):
+        cur = y * row_size + x
+        nx = x + dx
+        ny = y + dy
+        if out[cur] == 0 or nx < 0 or nx >= row_size or ny < 0 or ny >= rows:
+            return
+        neighbor = out[ny * row_size + nx]
+        if neighbor < 255:
+            out[cur] = min(out[cur], neighbor + 1)
+
+    for y in range(rows):
+        for x in range(row_size):
+            relax(x, y, -1, -1)
+            relax(x, y, 0, -1)
+            relax(x, y, 1, -1)
+            relax(x, y, -1, 0)
+    for y in reversed(range(rows)):
+        for x in reversed(range(row_size)):
+            relax(x, y, 1, 1)
+            relax(x, y, 0, 1)
+            relax(x, y, -1, 1)
+            relax(x, y, 1, 0)
+
+    return out
+
+
+def step_cost(field: list, dx: int, dy: int, to: int):
+    cost = 6 if dx != 0 and dy != 0 else 4
+    if field[to] < len(kClearanceCost):
+        cost += kClearanceCost[field[to]]
+
+    return cost
+
+
+def entrances(water: list, row_size: int, rows: int, cluster_size: int):
+    """The cell pairs where the routes cross the cluster borders, left or above first"""
+    out = []
+
+    def segments(pairs):
+        # pairs is a list of (a, b) cells along a border, or None where it's closed
+        run = []
+        for pair in pairs + [None]:
+            if pair is not None:
+                run.append(pair)
+                continue
+            if len(run) >= kLongEntrance:
+                out.append(run[0])
+                out.append(run[-1])
+            elif run:
+                out.append(run[len(run) // 2])
+            run = []
+
+    # Vertical borders
+    for x in range(cluster_size - 1, row_size - 1, cluster_size):
+        for top in range(0, rows, cluster_size):
+            pairs = []
+            for y in range(top, min(top + cluster_size, rows)):
+                a = y * row_size + x
+                pairs.append((a, a + 1) if water[a] and water[a + 1] else None)
+            segments(pairs)
+
+    # Horizontal borders
+    for y in range(cluster_size - 1, rows - 1, cluster_size):
+        for left in range(0, row_size, cluster_size):
+            pairs = []
+            for x in range(left, min(left + cluster_size, row_size)):
+                a = y * row_size + x
+                pairs.append((a, a + row_size) if water[a] and water[a + row_size] else None)
+            segments(pairs)
+
+    return out
+
+
+def cluster_costs(water, field, row_size, rows, cluster_size, start):
+    """The cost from start to the cells in its cluster, without leaving it"""
+    x0 = (start % row_size) // cluster_size * cluster_size
+    y0 = (start // row_size) // cluster_size * cluster_size
+    x1 = min(x0 + cluster_size, row_size)
+    y1 = min(y0 + cluster_size, rows)
+
+    costs = {start: 0}
+    queue = [(0, start)]
+    while queue:
+        cost, cur = heapq.heappop(queue)
+        if cost > costs[cur]:
+            continue
+        x = cur % row_size
+        y = cur // row_size
+        for dx, dy in kNeighbors:
+            nx = x + dx
+            ny = y + dy
+            if nx < x0 or nx >= x1 or ny < y0 or ny >= y1:
+                continue
+            neighbor = ny * row_size + nx
+            if not water[neighbor]:
+                continue
+            new_cost = cost + step_cost(field, dx, dy, neighbor)
+            if new_cost < costs.get(neighbor, 1 << 32):
+                costs[neighbor] = new_cost
+                heapq.heappush(queue, (new_cost, neighbor))
+
+    return costs
+
+
+def route_clusters(land_mask: list, row_size: int, rows: int, cluster_size: int):
+    """The RouteClusterHeader section of map.bin (see tile.hh)"""
+    water = unpack_land_mask(land_mask, row_size * rows)
+    field = clearance(water, row_size, rows)
+
+    cluster_row_size = (row_size + cluster_size - 1) // cluster_size
+    cluster_rows = (rows + cluster_size - 1) // cluster_size
+
+    def cluster_of(index):
+        return (index // row_size) // cluster_size * cluster_row_size + (
+            index % row_size
+        ) // cluster_size
+
+    pairs = entrances(water, row_size, rows, cluster_size)
+    cells = sorted(set(cell for pair in pairs for cell in pair), key=lambda c: (cluster_of(c), c))
+    node_of = {cell: node for node, cell in enumerate(cells)}
+
+    edges = [dict() for _ in cells]
+    for a, b in pairs:
+        dx = b % row_size - a % row_size
+        dy = b // row_size - a // row_size
+        edges[node_of[a]][node_of[b]] = step_cost(field, dx, dy, b)
+        edges[node_of[b]][node_of[a]] = step_cost(field, -dx, -dy, a)
+
+    first_node = [0] * (cluster_row_size * cluster_rows + 1)
+    for cell in cells:
+        first_node[cluster_of(cell) + 1] += 1
+    for cluster in range(1, len(first_node)):
+        first_node[cluster] += first_node[cluster - 1]
+
+    for cluster in range(cluster_row_size * cluster_rows):
+        nodes = range(first_node[cluster], first_node[cluster + 1])
+        for node in nodes:
+            costs = cluster_costs(water, field, row_size, rows, cluster_size, cells[node])
+            for other in nodes:
+                if other != node and cells[other] in costs:
+                    edges[node][other] = costs[cells[other]]
+
+    edge_count = sum(len(e) for e in edges)
+    out = [
+        struct.pack("<IIIII", cluster_size, cluster_row_size, cluster_rows, len(cells), edge_count)
+    ]
+    out.append(struct.pack("<{}I".format(len(first_node)), *first_node))
+
+    first_edge = 0
+    for node, cell in enumerate(cells):
+        out.append(struct.pack("<II", cell, first_edge))
+        first_edge += len(edges[node])
+    out.append(struct.pack("<II", 0xFFFFFFFF, first_edge))
+
+    for node_edges in edges:
+        for to, cost in sorted(node_edges.items()):
+            out.append(struct.pack("<II", to, cost))
+
+    print(
+        "route_data: {}x{} clusters, {} nodes and {} edges".format(
+            cluster_row_size, cluster_rows, len(cells), edge_count
+        )
+    )
+
+    return b"".join(out)
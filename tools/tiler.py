@@ -1,5 +1,7 @@
 #!/usr/bin/env python3
 
+import argparse
+import itertools
 import os
 import sys
 import struct
@@ -9,11 +11,79 @@ import yaml
 import PIL
 from PIL import Image
 
+from route_data import route_clusters
+
 # Allow huge images
 PIL.Image.MAX_IMAGE_PIXELS = 933120000
 
 kGpsTileSize = 256
 
+# The zoomed out tiles, which each cover zoom x zoom tiles (MapMetadata.zoomed_tile_data_offset)
+kZoomLevels = [2, 4]
+
+# TileCodec in tile.hh, stored in the upper byte of FlashTile.size
+kTileCodecPng = 0
+kTileCodecPaletteRle = 1
+
+# See tile_codec.hh
+kPaletteRleMaxColors = 64
+kPaletteRleShortRuns = 3
+kPaletteRleLongRunBase = 4
+kPaletteRleMaxRun = 255 + kPaletteRleLongRunBase
+
+# The order of the tile payloads in flash. The FlashTile tables are always row-major, so the
+# runtime doesn't care. The curves keep the tiles above and below close in flash as well
+kTileLayouts = ["row", "zorder", "hilbert"]
+
+
+def rgb_to_rgb565(r: int, g: int, b: int):
+    # Same as PNGdec
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+
+
+def encode_palette_rle(tile: Image):
+    if tile.mode != "P":
+        return None
+
+    pixels = tile.tobytes()
+    palette_size = max(pixels) + 1
+    if palette_size > kPaletteRleMaxColors:
+        return None
+
+    palette = tile.getpalette()
+    out = bytearray([palette_size])
+    for i in range(0, palette_size):
+        r, g, b = palette[i * 3 : i * 3 + 3]
+        out += struct.pack("<H", rgb_to_rgb565(r, g, b))
+
+    # The runs continue over the row ends
+    for color, group in itertools.groupby(pixels):
+        length = len(list(group))
+
+        while length > 0:
+            run = min(length, kPaletteRleMaxRun)
+            if run <= kPaletteRleShortRuns:
+                out.append(((run - 1) << 6) | color)
+            else:
+                out.append((kPaletteRleShortRuns << 6) | color)
+                out.append(run - kPaletteRleLongRunBase)
+            length -= run
+
+    return bytes(out)
+
+
+def encode_tile(tile: Image, codec: int):
+    if codec == kTileCodecPaletteRle:
+        bytes = encode_palette_rle(tile)
+        if bytes is not None:
+            return bytes, kTileCodecPaletteRle
+
+    # PNG for everything else
+    output = io.BytesIO()
+    tile.save(output, format="PNG")
+
+    return output.getvalue(), kTileCodecPng
+
 
 def get_tile_positions_to_ignore(yaml_data: dict, img: Image, tile_size: int):
     out = {}
@@ -51,6 +121,49 @@ def get_tile_positions_to_ignore(yaml_data: dict, img: Image, tile_size: int):
     return out
 
 
+def zorder_index(x: int, y: int):
+    out = 0
+    for bit in range(max(x, y).bit_length()):
+        out |= ((x >> bit) & 1) << (2 * bit)
+        out |= ((y >> bit) & 1) << (2 * bit + 1)
+
+    return out
+
+
+def hilbert_index(order: int, x: int, y: int):
+    # https://en.wikipedia.org/wiki/Hilbert_curve, xy2d on a 2^order square
+    out = 0
+    s = 1 << (order - 1) if order > 0 else 0
+    while s > 0:
+        rx = 1 if x & s else 0
+        ry = 1 if y & s else 0
+        out += s * s * ((3 * rx) ^ ry)
+
+        # Rotate the quadrant
+        if ry == 0:
+            if rx == 1:
+                x = s - 1 - x
+                y = s - 1 - y
+            x, y = y, x
+        s //= 2
+
+    return out
+
+
+def tile_order(row_length: int, rows: int, layout: str):
+    """The tile indices (row-major) in the order their payloads are laid out in flash"""
+    indices = list(range(row_length * rows))
+    if layout == "zorder":
+        indices.sort(key=lambda i: zorder_index(i % row_length, i // row_length))
+    elif layout == "hilbert":
+        order = max(row_length - 1, rows - 1, 1).bit_length()
+        indices.sort(key=lambda i: hilbert_index(order, i % row_length, i // row_length))
+    else:
+        assert layout == "row"
+
+    return indices
+
+
 def create_tiles(yaml_data: dict, img: Image, to_ignore: dict, tile_size: int):
     tiles = []
     cropped_width = img.size[0] - img.size[0] % tile_size
@@ -72,6 +185,31 @@ def create_tiles(yaml_data: dict, img: Image, to_ignore: dict, tile_size: int):
     return tiles
 
 
+def create_zoomed_tiles(img: Image, tile_size: int, zoom: int):
+    tiles = []
+    cropped_width = img.size[0] - img.size[0] % tile_size
+    cropped_height = img.size[1] - img.size[1] % tile_size
+    zoomed_size = tile_size * zoom
+
+    for y in range(0, cropped_height, zoomed_size):
+        for x in range(0, cropped_width, zoomed_size):
+            # Black outside the map, like the overview map background
+            area = Image.new("RGB", (zoomed_size, zoomed_size), (0, 0, 0))
+            area.paste(
+                img.crop(
+                    (x, y, min(x + zoomed_size, cropped_width), min(y + zoomed_size, cropped_height))
+                ).convert("RGB")
+            )
+
+            tile = area.resize((tile_size, tile_size), resample=Image.Resampling.BOX)
+            tile = tile.convert(
+                mode="P", palette=Image.ADAPTIVE, dither=Image.Dither.NONE, colors=64
+            )
+            tiles.append(tile)
+
+    return tiles
+
+
 def create_binary(
     yaml_data: dict,
     tiles: list,
@@ -79,6 +217,10 @@ def create_binary(
     gps_row_length: int,
     gps_rows: int,
     dst_file: str,
+    codec: int = kTileCodecPng,
+    zoomed_tiles: list = [],
+    layout: str = "row",
+    route_cluster_size: int = 32,
 ):
     data_size = 0
 
@@ -108,43 +250,91 @@ def create_binary(
         for x in range(0, land_only_tile.size[0]):
             land_only_tile.putpixel((x, y), (r, g, b))
 
-    output = io.BytesIO()
-    land_only_tile.save(output, format="PNG")
-    bytes = output.getvalue()
+    bytes, land_only_codec = encode_tile(land_only_tile, codec)
 
     land_only_size = len(bytes)
 
-    header_format = "<QffffIIIIIIIIII"
+    header_format = "<QffffIIIIIIIIIIIIII"
     header_size = struct.calcsize(header_format)
-    assert header_size == 64
+    assert header_size == 80
 
     # Starts after the MapMetadata header and all FlashTile:s
     land_only_offset = header_size + len(tiles) * 8
 
     data_size += len(bytes)
 
-    tile_metadata = []
     tile_data = bytes
 
+    # Identical tiles (open water, inland) share one payload, which the tile producer also
+    # decodes only once
+    payload_offsets = {(bytes, land_only_codec): land_only_offset}
+    shared_tiles = 0
+
     current_offset = land_only_offset + len(bytes)
-    for index, tile in enumerate(tiles):
+    tile_metadata = [None] * len(tiles)
+    for index in tile_order(row_length, len(tiles) // row_length, layout):
+        tile = tiles[index]
         bytes = []
 
         if tile is None:
-            tile_metadata.append((land_only_size, land_only_offset))
+            tile_metadata[index] = (land_only_size, land_only_codec, land_only_offset)
             continue
 
-        output = io.BytesIO()
-        tile.save(output, format="PNG")
-        bytes = output.getvalue()
+        bytes, tile_codec = encode_tile(tile, codec)
+
+        if (bytes, tile_codec) in payload_offsets:
+            tile_metadata[index] = (len(bytes), tile_codec, payload_offsets[(bytes, tile_codec)])
+            shared_tiles += 1
+            continue
+        payload_offsets[(bytes, tile_codec)] = current_offset
 
         # Copy bytes to tile_data
-        tile_metadata.append((len(bytes), current_offset))
+        tile_metadata[index] = (len(bytes), tile_codec, current_offset)
         tile_data += bytes
 
         data_size += len(bytes)
         current_offset += len(bytes)
 
+    # The zoomed out tiles: a FlashTile table per level, followed by the tile data
+    zoomed_tile_data_offsets = []
+    zoomed_tile_data = b""
+    for zoom, level_tiles in zip(kZoomLevels, zoomed_tiles):
+        zoomed_tile_data_offsets.append(current_offset)
+
+        level_metadata = [None] * len(level_tiles)
+        level_data = b""
+        data_offset = current_offset + len(level_tiles) * 8
+        level_row_length = (row_length + zoom - 1) // zoom
+        for index in tile_order(level_row_length, len(level_tiles) // level_row_length, layout):
+            bytes, tile_codec = encode_tile(level_tiles[index], codec)
+            assert len(bytes) < (1 << 24)
+
+            if (bytes, tile_codec) in payload_offsets:
+                level_metadata[index] = struct.pack(
+                    "<II", len(bytes) | (tile_codec << 24), payload_offsets[(bytes, tile_codec)]
+                )
+                shared_tiles += 1
+                continue
+            payload_offsets[(bytes, tile_codec)] = data_offset
+
+            level_metadata[index] = struct.pack("<II", len(bytes) | (tile_codec << 24), data_offset)
+            level_data += bytes
+            data_offset += len(bytes)
+
+        zoomed_tile_data += b"".join(level_metadata) + level_data
+        data_size += len(level_data)
+        current_offset = data_offset
+
+    print(
+        "tiler: {} of {} tiles share the payload of another tile".format(
+            shared_tiles, len(tiles) + sum(len(level) for level in zoomed_tiles)
+        )
+    )
+
+    # Zero for missing levels
+    while len(zoomed_tile_data_offsets) < len(kZoomLevels):
+        zoomed_tile_data_offsets.append(0)
+
     # Pack metadata and tile_data into the bin_file, little endian format
 
     bin_file = open(dst_file, "wb")
@@ -157,7 +347,9 @@ def create_binary(
     land_mask_row_size = path_finder_row_length
     land_mask_rows = (tile_rows * tile_size) // path_finder_tile_size
     tile_data_offset = header_size  # After the header
-    land_mask_data_offset = tile_data_offset + len(tile_metadata) * 8 + len(tile_data)
+    land_mask_data_offset = (
+        tile_data_offset + len(tile_metadata) * 8 + len(tile_data) + len(zoomed_tile_data)
+    )
 
     # Align the land mask to 4 bytes
     if land_mask_data_offset % 4 != 0:
@@ -165,6 +357,15 @@ def create_binary(
 
     gps_data_offset = land_mask_data_offset + len(land_mask)
 
+    route_cluster_data = b""
+    route_cluster_offset = 0
+    if route_cluster_size != 0:
+        route_cluster_data = route_clusters(
+            land_mask_yaml_data, path_finder_row_length, land_mask_rows, route_cluster_size
+        )
+        # After the GPS data, which is 16 byte aligned
+        route_cluster_offset = gps_data_offset + gps_row_length * gps_rows * 16
+
     lowest_latitude = 200
     highest_latitude = -200
     lowest_longitude = 200
@@ -200,18 +401,25 @@ def create_binary(
         tile_data_offset,
         land_mask_data_offset,
         gps_data_offset,
+        *zoomed_tile_data_offsets,
+        route_cluster_offset,
+        0,
     )
 
     offset = bin_file.write(header_data)
 
     assert offset == tile_data_offset
-    for size, png_offset in tile_metadata:
-        cur = bin_file.write(struct.pack("<II", size, png_offset))
+    for size, tile_codec, tile_offset in tile_metadata:
+        assert size < (1 << 24)
+        cur = bin_file.write(struct.pack("<II", size | (tile_codec << 24), tile_offset))
         assert cur == 8
         offset += cur
 
     offset += bin_file.write(tile_data)
 
+    assert zoomed_tiles == [] or offset == zoomed_tile_data_offsets[0]
+    offset += bin_file.write(zoomed_tile_data)
+
     # Align the land mask to 4 bytes
     while offset % 4 != 0:
         offset += bin_file.write(b"\xaa")
@@ -234,7 +442,12 @@ def create_binary(
         gps_data[index] = [entry["latitude"], entry["longitude"], entry["latitude_offset"], entry["longitude_offset"]]
 
     for latitude, longitude, latitude_offset, longitude_offset in gps_data:
-        bin_file.write(struct.pack("<ffff", latitude, longitude, latitude_offset, longitude_offset))
+        offset += bin_file.write(
+            struct.pack("<ffff", latitude, longitude, latitude_offset, longitude_offset)
+        )
+
+    assert route_cluster_offset == 0 or offset == route_cluster_offset
+    offset += bin_file.write(route_cluster_data)
 
     return data_size
 
@@ -248,11 +461,31 @@ def save_tiles(tiles: list, num_colors):
 
 
 if __name__ == "__main__":
-    if len(sys.argv) != 3:
-        print("Usage: {} <input_yaml_file> <output_file>".format(sys.argv[0]))
-        sys.exit(1)
+    parser = argparse.ArgumentParser()
+    parser.add_argument("input_yaml_file")
+    parser.add_argument("output_file")
+    parser.add_argument(
+        "--codec",
+        choices=["png", "rle"],
+        default="png",
+        help="Tile codec. rle (palette + run-length) is larger, but faster to decode",
+    )
+    parser.add_argument(
+        "--layout",
+        choices=kTileLayouts,
+        default="row",
+        help="Tile payload order in flash. The curves keep neighboring tiles in the same flash "
+        "pages, see tools/flash_pages.py",
+    )
+    parser.add_argument(
+        "--route-cluster-size",
+        type=int,
+        default=32,
+        help="Land mask cells per side of the hierarchical routing clusters, 0 for none",
+    )
+    args = parser.parse_args()
 
-    yaml_data = yaml.safe_load(open(sys.argv[1], "r"))
+    yaml_data = yaml.safe_load(open(args.input_yaml_file, "r"))
 
     if "map_filename" not in yaml_data or "tile_size" not in yaml_data:
         print(
@@ -282,17 +515,23 @@ if __name__ == "__main__":
     gps_row_length = int(img.size[0] / kGpsTileSize)
     gps_rows = int(img.size[1] / kGpsTileSize)
 
+    zoomed_tiles = [create_zoomed_tiles(img, tile_size, zoom) for zoom in kZoomLevels]
+
     data_size = create_binary(
         yaml_data,
         tiles,
         row_length=tile_row_length,
         gps_row_length=gps_row_length,
         gps_rows=gps_rows,
-        dst_file=sys.argv[2],
+        dst_file=args.output_file,
+        codec=kTileCodecPaletteRle if args.codec == "rle" else kTileCodecPng,
+        zoomed_tiles=zoomed_tiles,
+        layout=args.layout,
+        route_cluster_size=args.route_cluster_size,
     )
 
     print(
-        "tiler: Converted to {} tiles ({} ignored), total size: {:.2f} KiB".format(
-            len(tiles), len(to_ignore), data_size / 1024.0
+        "tiler: Converted to {} tiles ({} ignored) + {} zoomed out, total size: {:.2f} KiB".format(
+            len(tiles), len(to_ignore), sum(len(level) for level in zoomed_tiles), data_size / 1024.0
         )
     )